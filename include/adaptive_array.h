@@ -0,0 +1,207 @@
+//
+// AdaptiveExpansionArray: two-term float expansions where the low term is only
+// stored for elements that need it.
+//
+// The leading terms are a plain aligned float array. The elements are grouped
+// in blocks of ADAPTIVE_BLOCK; a block owns a slot of low terms in a side pool
+// only if one of its elements has |e2| > tol*|e1|, and a bitmask records which
+// ones. Kernels work block by block and never read or write the low terms of a
+// block without any, so fields that are mostly exact in float cost close to
+// float memory traffic. Such blocks also take plain float arithmetic when its
+// rounding errors are bounded by tol, and so would be dropped anyway. Low
+// terms that become negligible are dropped and empty slots are recycled.
+//
+
+#ifndef EXPFLOAT_ADAPTIVE_ARRAY_H
+#define EXPFLOAT_ADAPTIVE_ARRAY_H
+
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include <expansion_math.h>
+#include <expansion_simd.h>
+#include <expansion_array.h>
+
+#define ADAPTIVE_BLOCK 64
+
+class AdaptiveExpansionArray {
+public:
+    // @param tol  low terms with |e2| <= tol*|e1| are not stored
+    AdaptiveExpansionArray(unsigned long n, float tol)
+        : m_n(n), m_nb((n + ADAPTIVE_BLOCK - 1) / ADAPTIVE_BLOCK), m_tol(tol),
+          m_mask(m_nb, 0), m_slot(m_nb, -1) {
+        m_hi = exp_aligned_alloc<float>(n);
+        memset(m_hi, 0, n * sizeof(float));
+    }
+
+    ~AdaptiveExpansionArray() { free(m_hi); }
+
+    AdaptiveExpansionArray(const AdaptiveExpansionArray&) = delete;
+    AdaptiveExpansionArray& operator= (const AdaptiveExpansionArray&) = delete;
+
+    unsigned long size() const { return m_n; }
+
+    // @brief zero-copy view of the leading terms
+    float*       top()       { return m_hi; }
+    const float* top() const { return m_hi; }
+
+    void get(unsigned long i, float& e1, float& e2) const {
+        unsigned long kb = i / ADAPTIVE_BLOCK, j = i % ADAPTIVE_BLOCK;
+        e1 = m_hi[i];
+        e2 = (m_mask[kb] >> j & 1) ? m_lo[m_slot[kb] + j] : 0.0f;
+    }
+
+    void set(unsigned long i, float e1, float e2) {
+        unsigned long kb = i / ADAPTIVE_BLOCK;
+        float lo[ADAPTIVE_BLOCK];
+
+        load_low(kb, lo);
+        m_hi[i] = e1;
+        lo[i % ADAPTIVE_BLOCK] = e2;
+        store_low(kb, lo);
+    }
+
+    // @brief split wider values (double, __float128) into (e1, e2)
+    template <typename U>
+    void assign(const U* v) {
+        float lo[ADAPTIVE_BLOCK];
+        for (unsigned long kb = 0; kb < m_nb; ++kb) {
+            unsigned long off = kb * ADAPTIVE_BLOCK, len = std::min(m_n - off, (unsigned long)ADAPTIVE_BLOCK);
+            for (unsigned long j = 0; j < len; ++j) {
+                m_hi[off + j] = static_cast<float>(v[off + j]);
+                lo[j] = static_cast<float>(v[off + j] - m_hi[off + j]);
+            }
+            store_low(kb, lo);
+        }
+    }
+
+    // @brief number of elements that carry a low term
+    unsigned long low_count() const {
+        unsigned long c = 0;
+        for (unsigned long kb = 0; kb < m_nb; ++kb)
+            c += __builtin_popcountll(m_mask[kb]);
+        return c;
+    }
+
+    // @brief bytes held: leading terms, allocated low-term slots and the bitmask
+    unsigned long bytes() const {
+        return m_n * sizeof(float) + (m_lo.size() - m_free.size() * ADAPTIVE_BLOCK) * sizeof(float)
+               + m_nb * sizeof(uint64_t);
+    }
+
+    // @brief drop all low terms that are negligible at the current tolerance
+    void renormalize() {
+        float lo[ADAPTIVE_BLOCK];
+        for (unsigned long kb = 0; kb < m_nb; ++kb) {
+            if (!m_mask[kb])
+                continue;
+            load_low(kb, lo);
+            store_low(kb, lo);
+        }
+    }
+
+    // @brief x[i] += b[i]
+    void add(const float* b) {
+        float lo[ADAPTIVE_BLOCK];
+        for (unsigned long kb = 0; kb < m_nb; ++kb) {
+            unsigned long off = kb * ADAPTIVE_BLOCK, len = std::min(m_n - off, (unsigned long)ADAPTIVE_BLOCK);
+            if (!m_mask[kb] && plain_axpy(off, len, 1.0f, b))
+                continue;
+            load_low(kb, lo);
+            grow_expansion_array(m_hi + off, lo, b + off, len);
+            store_low(kb, lo);
+        }
+    }
+
+    // @brief x[i] = a * x[i] + b[i], as daxpy
+    void daxpy(float a, const float* b) {
+        float lo[ADAPTIVE_BLOCK];
+        for (unsigned long kb = 0; kb < m_nb; ++kb) {
+            unsigned long off = kb * ADAPTIVE_BLOCK, len = std::min(m_n - off, (unsigned long)ADAPTIVE_BLOCK);
+            if (!m_mask[kb] && plain_axpy(off, len, a, b))
+                continue;
+            load_low(kb, lo);
+            daxpy_array(m_hi + off, lo, a, b + off, len);
+            store_low(kb, lo);
+        }
+    }
+
+private:
+    // @brief x[i] = a * x[i] + b[i] in plain float over the block at off,
+    // which has no low terms. The two roundings are off by at most
+    // eps/2 (|a x| + |x'|), checked with eps to cover the rounding in |a x|
+    // as well; if that is above tol |x'| for some element, x is left alone
+    // and false returned, for the expansion kernel to keep the error as a
+    // low term. Below tol = eps it always is, and nothing is tried.
+    bool plain_axpy(unsigned long off, unsigned long len, float a, const float* b) {
+        float r[ADAPTIVE_BLOCK];
+        int small = 1;
+        if (m_tol < FLT_EPSILON)
+            return false;
+        for (unsigned long j = 0; j < len; ++j) {
+            float p = a * m_hi[off + j];
+            r[j] = p + b[off + j];
+            small &= FLT_EPSILON * (fabsf(p) + fabsf(r[j])) <= m_tol * fabsf(r[j]);
+        }
+        if (!small)
+            return false;
+        memcpy(m_hi + off, r, len * sizeof(float));
+        return true;
+    }
+
+    // @brief the low terms of block kb into lo, zeros where absent
+    void load_low(unsigned long kb, float* lo) const {
+        uint64_t mask = m_mask[kb];
+        if (!mask) {
+            memset(lo, 0, ADAPTIVE_BLOCK * sizeof(float));
+            return;
+        }
+        const float* src = &m_lo[m_slot[kb]];
+        for (int j = 0; j < ADAPTIVE_BLOCK; ++j)
+            lo[j] = (mask >> j & 1) ? src[j] : 0.0f;
+    }
+
+    // @brief keep the non-negligible entries of lo for block kb, releasing
+    // the slot if none are left
+    void store_low(unsigned long kb, const float* lo) {
+        unsigned long off = kb * ADAPTIVE_BLOCK, len = std::min(m_n - off, (unsigned long)ADAPTIVE_BLOCK);
+        uint64_t mask = 0;
+
+        for (unsigned long j = 0; j < len; ++j)
+            if (lo[j] != 0.0f && fabsf(lo[j]) > m_tol * fabsf(m_hi[off + j]))
+                mask |= (uint64_t)1 << j;
+
+        if (!mask) {
+            if (m_slot[kb] >= 0) {
+                m_free.push_back(m_slot[kb]);
+                m_slot[kb] = -1;
+            }
+        } else {
+            if (m_slot[kb] < 0) {
+                if (m_free.empty()) {
+                    m_slot[kb] = m_lo.size();
+                    m_lo.resize(m_lo.size() + ADAPTIVE_BLOCK);
+                } else {
+                    m_slot[kb] = m_free.back();
+                    m_free.pop_back();
+                }
+            }
+            memcpy(&m_lo[m_slot[kb]], lo, len * sizeof(float));
+        }
+        m_mask[kb] = mask;
+    }
+
+    unsigned long m_n, m_nb;
+    float m_tol;
+    float* m_hi;
+    std::vector<uint64_t> m_mask;
+    std::vector<long> m_slot;
+    std::vector<float> m_lo;
+    std::vector<long> m_free;
+};
+
+#endif //EXPFLOAT_ADAPTIVE_ARRAY_H
@@ -0,0 +1,332 @@
+//
+// A small benchmark harness, in the spirit of Google Benchmark.
+//
+// Benchmarks register a name, a type label and a function taking a
+// bench::State. The function does its (untimed) setup, then hands the kernel
+// to State::measure, which runs it for a number of warmup calls followed by
+// timed repetitions. Every benchmark runs once for each requested size; the
+// results are reported as median / mean / stddev / min per call, per element
+// and, for benchmarks that set State::bytes, in bytes per second, as a text
+// table, JSON or CSV. Benchmarks named "family/variant" compete: for every
+// family, type and size the variant with the lowest median is marked as the
+// fastest, and fastest_variant() reads the choice back; pick() runs the same
+// contest at run time on the caller's data. Timing uses the calibrated timer
+// of utils.h; cycles per element are TSC reference cycles and only reported
+// with an invariant TSC.
+//
+
+#ifndef EXPFLOAT_BENCH_H
+#define EXPFLOAT_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <utils.h>
+
+namespace bench {
+
+// @brief keep the compiler from optimizing v (and what it depends on) away
+template <typename T>
+inline void keep(T const& v) {
+    __asm__ __volatile__ ("" : : "g"(&v) : "memory");
+}
+
+struct Result {
+    std::string name, type;
+    unsigned long size, items, bytes;
+    int reps;
+    double median, mean, stddev, min;   // seconds per call
+    bool fastest;                       // lowest median of its family, type and size
+
+    double ns_per_element() const { return median / items * 1e9; }
+    // @brief bytes per second at the median, or a negative value if not set
+    double bytes_per_second() const { return bytes && median > 0 ? bytes / median : -1.0; }
+    // @brief TSC cycles per element, or a negative value without an invariant TSC
+    double cycles_per_element() const { return timer_info().tsc ? median * timer_info().frequency / items : -1.0; }
+};
+
+struct Options {
+    Options() : warmup(2), reps(10), format("text"), out(NULL) {
+        sizes.push_back(1 << 10);
+        sizes.push_back(1 << 16);
+        sizes.push_back(1 << 20);
+    }
+
+    int warmup, reps;
+    std::string format, filter;
+    std::vector<unsigned long> sizes;
+    FILE* out;
+};
+
+class State {
+public:
+    State(unsigned long n, const Options& opt) : n(n), items(n), bytes(0), m_opt(opt) { }
+
+    // @brief time f: warmup calls first, then one sample per repetition
+    template <typename F>
+    void measure(F f) {
+        for (int r = 0; r < m_opt.warmup; ++r)
+            f();
+        m_samples.clear();
+        for (int r = 0; r < m_opt.reps; ++r) {
+            uint64_t t0 = timer_ticks();
+            f();
+            uint64_t t1 = timer_ticks_end();
+            m_samples.push_back(timer_seconds(t1 - t0));
+        }
+    }
+
+    const std::vector<double>& samples() const { return m_samples; }
+
+    const unsigned long n;
+    // elements processed per call, for the per-element numbers; n unless set
+    unsigned long items;
+    // bytes processed per call, for bytes per second; not reported unless set
+    unsigned long bytes;
+
+private:
+    const Options& m_opt;
+    std::vector<double> m_samples;
+};
+
+struct Benchmark {
+    std::string name, type;
+    std::function<void(State&)> fn;
+};
+
+inline std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> r;
+    return r;
+}
+
+// @brief register a benchmark; returns true so it can initialize a static
+inline bool add(const std::string& name, const std::string& type, std::function<void(State&)> fn) {
+    Benchmark b;
+    b.name = name;
+    b.type = type;
+    b.fn = fn;
+    registry().push_back(b);
+    return true;
+}
+
+inline Result summarize(const std::string& name, const std::string& type, unsigned long n,
+                        unsigned long items, unsigned long bytes, std::vector<double> s) {
+    Result r;
+    r.name = name;
+    r.type = type;
+    r.size = n;
+    r.items = items;
+    r.bytes = bytes;
+    r.reps = s.size();
+    r.median = r.mean = r.stddev = r.min = 0.0;
+    r.fastest = false;
+    if (s.empty())
+        return r;
+
+    std::sort(s.begin(), s.end());
+    r.min = s[0];
+    r.median = s.size() % 2 ? s[s.size()/2] : 0.5 * (s[s.size()/2 - 1] + s[s.size()/2]);
+    for (size_t i = 0; i < s.size(); ++i)
+        r.mean += s[i];
+    r.mean /= s.size();
+    for (size_t i = 0; i < s.size(); ++i)
+        r.stddev += (s[i] - r.mean) * (s[i] - r.mean);
+    r.stddev = s.size() > 1 ? sqrt(r.stddev / (s.size() - 1)) : 0.0;
+    return r;
+}
+
+// @brief "sum/lanes8" -> "sum"; empty for names without a variant
+inline std::string family(const std::string& name) {
+    size_t k = name.rfind('/');
+    return k == std::string::npos ? std::string() : name.substr(0, k);
+}
+
+// @brief mark the fastest variant of every family, type and size with more than one variant
+inline void pick_fastest(std::vector<Result>& res) {
+    for (size_t i = 0; i < res.size(); ++i) {
+        std::string fi = family(res[i].name);
+        if (fi.empty())
+            continue;
+        size_t best = i, count = 0;
+        for (size_t j = 0; j < res.size(); ++j) {
+            if (family(res[j].name) != fi || res[j].type != res[i].type || res[j].size != res[i].size)
+                continue;
+            ++count;
+            if (res[j].median < res[best].median)
+                best = j;
+        }
+        res[i].fastest = count > 1 && best == i;
+    }
+}
+
+// @brief the variant that won family, type and size in res (the part of its
+// name after the family), or "" if there was no contest
+inline std::string fastest_variant(const std::vector<Result>& res, const std::string& fam,
+                                   const std::string& type, unsigned long size) {
+    for (size_t i = 0; i < res.size(); ++i)
+        if (res[i].fastest && res[i].type == type && res[i].size == size && family(res[i].name) == fam)
+            return res[i].name.substr(fam.size() + 1);
+    return std::string();
+}
+
+// @brief the same contest at run time, on the caller's own data: time every
+// candidate (one warmup call, then the median of reps) and return the index
+// of the fastest, so that code can settle on e.g. the branchy or the select
+// form of a kernel for the input pattern it actually has
+inline size_t pick(const std::vector<std::function<void()> >& candidates, int reps = 5) {
+    size_t best = 0;
+    double best_median = 0.0;
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        std::vector<double> s;
+        candidates[c]();
+        for (int r = 0; r < reps; ++r) {
+            uint64_t t = timer_ticks();
+            candidates[c]();
+            s.push_back(timer_seconds(timer_ticks() - t));
+        }
+        std::sort(s.begin(), s.end());
+        if (c == 0 || s[s.size() / 2] < best_median) {
+            best = c;
+            best_median = s[s.size() / 2];
+        }
+    }
+    return best;
+}
+
+inline void report(const std::vector<Result>& res, const Options& opt) {
+    FILE* f = opt.out ? opt.out : stdout;
+    char cyc[32], bps[32];
+
+    if (opt.format == "json") {
+        fprintf(f, "{\n  \"timer\": \"%s\", \"tsc_ghz\": %.6g,\n  \"benchmarks\": [\n",
+                timer_info().tsc ? "tsc" : "steady_clock", timer_info().tsc ? timer_info().frequency * 1e-9 : 0.0);
+        for (size_t i = 0; i < res.size(); ++i) {
+            const Result& r = res[i];
+            if (r.cycles_per_element() < 0)
+                snprintf(cyc, sizeof(cyc), "null");
+            else
+                snprintf(cyc, sizeof(cyc), "%.6g", r.cycles_per_element());
+            if (r.bytes_per_second() < 0)
+                snprintf(bps, sizeof(bps), "null");
+            else
+                snprintf(bps, sizeof(bps), "%.6g", r.bytes_per_second());
+            fprintf(f, "    {\"name\": \"%s\", \"type\": \"%s\", \"size\": %lu, \"repetitions\": %d, "
+                       "\"median_s\": %.9e, \"mean_s\": %.9e, \"stddev_s\": %.9e, \"min_s\": %.9e, "
+                       "\"ns_per_element\": %.6g, \"cycles_per_element\": %s, \"bytes_per_second\": %s, "
+                       "\"fastest\": %s}%s\n",
+                    r.name.c_str(), r.type.c_str(), r.size, r.reps, r.median, r.mean, r.stddev, r.min,
+                    r.ns_per_element(), cyc, bps, r.fastest ? "true" : "false", i + 1 < res.size() ? "," : "");
+        }
+        fprintf(f, "  ]\n}\n");
+    } else if (opt.format == "csv") {
+        fprintf(f, "name,type,size,repetitions,median_s,mean_s,stddev_s,min_s,ns_per_element,cycles_per_element,"
+                   "bytes_per_second,fastest\n");
+        for (size_t i = 0; i < res.size(); ++i) {
+            const Result& r = res[i];
+            cyc[0] = bps[0] = '\0';
+            if (r.cycles_per_element() >= 0)
+                snprintf(cyc, sizeof(cyc), "%.6g", r.cycles_per_element());
+            if (r.bytes_per_second() >= 0)
+                snprintf(bps, sizeof(bps), "%.6g", r.bytes_per_second());
+            fprintf(f, "%s,%s,%lu,%d,%.9e,%.9e,%.9e,%.9e,%.6g,%s,%s,%d\n", r.name.c_str(), r.type.c_str(), r.size,
+                    r.reps, r.median, r.mean, r.stddev, r.min, r.ns_per_element(), cyc, bps, r.fastest);
+        }
+    } else {
+        fprintf(f, "%-40s %-8s %10s %12s %12s %12s %10s %10s %10s\n",
+                "benchmark", "type", "size", "median(s)", "stddev(s)", "min(s)", "ns/elem", "cyc/elem", "GB/s");
+        for (size_t i = 0; i < res.size(); ++i) {
+            const Result& r = res[i];
+            snprintf(cyc, sizeof(cyc), "-");
+            snprintf(bps, sizeof(bps), "-");
+            if (r.cycles_per_element() >= 0)
+                snprintf(cyc, sizeof(cyc), "%.4g", r.cycles_per_element());
+            if (r.bytes_per_second() >= 0)
+                snprintf(bps, sizeof(bps), "%.4g", r.bytes_per_second() * 1e-9);
+            fprintf(f, "%-40s %-8s %10lu %12.4e %12.4e %12.4e %10.4g %10s %10s%s\n", r.name.c_str(), r.type.c_str(),
+                    r.size, r.median, r.stddev, r.min, r.ns_per_element(), cyc, bps, r.fastest ? "  *" : "");
+        }
+        fprintf(f, "\nfastest variants:\n");
+        for (size_t i = 0; i < res.size(); ++i) {
+            const Result& r = res[i];
+            if (r.fastest)
+                fprintf(f, "  %-40s %-8s %10lu  %s\n", family(r.name).c_str(), r.type.c_str(), r.size,
+                        r.name.substr(family(r.name).size() + 1).c_str());
+        }
+    }
+}
+
+// @brief parse --format=, --filter=, --reps=, --warmup=, --sizes=a,b,c and --out=
+inline Options parse(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        std::string v = a.find('=') == std::string::npos ? "" : a.substr(a.find('=') + 1);
+
+        if (a.compare(0, 9, "--format=") == 0)
+            opt.format = v;
+        else if (a.compare(0, 9, "--filter=") == 0)
+            opt.filter = v;
+        else if (a.compare(0, 7, "--reps=") == 0)
+            opt.reps = atoi(v.c_str());
+        else if (a.compare(0, 9, "--warmup=") == 0)
+            opt.warmup = atoi(v.c_str());
+        else if (a.compare(0, 8, "--sizes=") == 0) {
+            opt.sizes.clear();
+            for (char* tok = strtok(&v[0], ","); tok; tok = strtok(NULL, ","))
+                opt.sizes.push_back(strtoul(tok, NULL, 10));
+        } else if (a.compare(0, 6, "--out=") == 0) {
+            opt.out = fopen(v.c_str(), "w");
+            if (!opt.out) {
+                fprintf(stderr, "error: cannot open %s\n", v.c_str());
+                exit(1);
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--format=text|json|csv] [--filter=substr] [--reps=N] [--warmup=N]"
+                            " [--sizes=n1,n2,...] [--out=file]\n", argv[0]);
+            exit(a == "--help" ? 0 : 1);
+        }
+    }
+    return opt;
+}
+
+// @brief run every registered benchmark matching the filter for every size
+inline int run(int argc, char* argv[]) {
+    Options opt = parse(argc, argv);
+    std::vector<Result> res;
+
+    for (size_t b = 0; b < registry().size(); ++b) {
+        const Benchmark& bm = registry()[b];
+        std::string full = bm.name + "/" + bm.type;
+        if (!opt.filter.empty() && full.find(opt.filter) == std::string::npos)
+            continue;
+        for (size_t k = 0; k < opt.sizes.size(); ++k) {
+            State s(opt.sizes[k], opt);
+            bm.fn(s);
+            res.push_back(summarize(bm.name, bm.type, s.n, s.items, s.bytes, s.samples()));
+        }
+    }
+
+    pick_fastest(res);
+    report(res, opt);
+    if (opt.out)
+        fclose(opt.out);
+    return 0;
+}
+
+} // namespace bench
+
+#define BENCH_CAT2(a, b) a ## b
+#define BENCH_CAT(a, b)  BENCH_CAT2(a, b)
+
+// @brief BENCHMARK("name", "type", [](bench::State& s) { ... });
+#define BENCHMARK(name, type, ...) \
+    static bool BENCH_CAT(bench_registered_, __LINE__) = bench::add(name, type, __VA_ARGS__)
+
+#endif //EXPFLOAT_BENCH_H
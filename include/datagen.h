@@ -0,0 +1,173 @@
+//
+// Test data: uniform random arrays and sine tables, generated in parallel.
+//
+// Random values come from one mt19937_64 stream per block of GEN_BLOCK
+// elements, seeded with (seed, block index). As for the reductions of
+// expansion_parallel.h, the threads only decide who fills which block, so the
+// data depend on the seed alone and not on the number of threads. The sine
+// tables evaluate every element on its own and are split over threads as is;
+// sinq is software quad, so it is the threads and not SIMD that pay here.
+// The ill-conditioned and cancellation-heavy sums are built from a running
+// exact sum and shuffled as a whole, so they are generated serially.
+//
+// With EXPFLOAT_DATA_CACHE set to a directory, gen_cached() keeps generated
+// arrays there under a key made from the generator and its parameters, and
+// reads them back instead of generating them again.
+//
+
+#ifndef EXPFLOAT_DATAGEN_H
+#define EXPFLOAT_DATAGEN_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include <quadmath.h>
+
+#define GEN_BLOCK 65536
+
+// @brief EXPFLOAT_SEED from the environment, otherwise def
+inline uint64_t gen_seed(uint64_t def = 42) {
+    const char* env = getenv("EXPFLOAT_SEED");
+    return env && *env ? strtoull(env, NULL, 0) : def;
+}
+
+// @brief v[0..n) uniform in [lo, hi), the same for any number of threads
+template <typename T>
+inline void gen_uniform(T* v, unsigned long n, uint64_t seed, double lo = 0.0, double hi = 1.0) {
+    long nb = (n + GEN_BLOCK - 1) / GEN_BLOCK;
+
+    #pragma omp parallel for schedule(static)
+    for (long kb = 0; kb < nb; ++kb) {
+        std::seed_seq seq = {(uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)kb, (uint32_t)((uint64_t)kb >> 32)};
+        std::mt19937_64 mt(seq);
+        std::uniform_real_distribution<double> dist(lo, hi);
+        unsigned long end = std::min(n, (unsigned long)(kb + 1) * GEN_BLOCK);
+        for (unsigned long i = kb * GEN_BLOCK; i < end; ++i)
+            v[i] = dist(mt);
+    }
+}
+
+// @brief v[j] = sin(2 pi (first + j) / n / periods) for j < len, in quad
+inline void gen_sine(__float128* v, unsigned long first, unsigned long len, unsigned long n,
+                     unsigned long periods = 1) {
+    #pragma omp parallel for schedule(static)
+    for (long j = 0; j < (long)len; ++j)
+        v[j] = sinq(M_PIq * 2 * (first + j) / n / periods);
+}
+
+// @brief as above in double
+inline void gen_sine(double* v, unsigned long first, unsigned long len, unsigned long n,
+                     unsigned long periods = 1) {
+    #pragma omp parallel for schedule(static)
+    for (long j = 0; j < (long)len; ++j)
+        v[j] = sin(M_PI * 2 * (first + j) / n / periods);
+}
+
+// @brief v[0..n) with sum |v_i| / |sum v_i| within a small factor of cond,
+// after GenSum of Ogita, Rump & Oishi: the first half has random signs and
+// exponents in [0, b], the second half cancels the exact running sum down
+// while its exponents fall linearly to 0, which leaves a sum of order 1; then
+// the whole array is shuffled. The n values average about 2^b / b, so b is
+// log2(cond / n), and at least 1.
+template <typename T>
+inline void gen_ill_conditioned(T* v, unsigned long n, uint64_t seed, double cond) {
+    std::mt19937_64 mt(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    unsigned long h = n / 2;
+    double b = std::max(1.0, log2(cond / n));
+    __float128 s = 0;
+
+    for (unsigned long i = 0; i < h; ++i) {
+        v[i] = ldexp(dist(mt), i == 0 ? (int)b : (int)(b * (dist(mt) + 1) / 2));
+        s += v[i];
+    }
+    for (unsigned long i = h; i < n; ++i) {
+        v[i] = (double)(ldexp(dist(mt), (int)(b * (n - 1 - i) / std::max(1ul, n - 1 - h))) - s);
+        s += v[i];
+    }
+    std::shuffle(v, v + n, mt);
+}
+
+// @brief v[0..n): half of it pairs +x, -x with x uniform in [0, scale), which
+// cancel exactly, and half uniform in [0, 1), which make up the sum; shuffled
+template <typename T>
+inline void gen_cancellation(T* v, unsigned long n, uint64_t seed, double scale) {
+    std::mt19937_64 mt(seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    unsigned long i = 0;
+
+    for (; i + 1 < n / 2; i += 2) {
+        v[i] = scale * dist(mt);
+        v[i + 1] = -v[i];
+    }
+    for (; i < n; ++i)
+        v[i] = dist(mt);
+    std::shuffle(v, v + n, mt);
+}
+
+struct GenCacheHeader {
+    char magic[8];          // "EXPGEN01"
+    uint64_t value_size;
+    uint64_t n;
+};
+
+// @brief the cache file for key, or "" if EXPFLOAT_DATA_CACHE is not set
+inline std::string gen_cache_path(const std::string& key) {
+    const char* dir = getenv("EXPFLOAT_DATA_CACHE");
+    if (!dir || !*dir)
+        return std::string();
+    return std::string(dir) + "/" + key + ".bin";
+}
+
+// @brief fill v[0..n) from the cache file for key if there is one that
+// matches, otherwise with generate(v) and store the result for the next run.
+// key has to name everything the data depend on (generator, n, seed, ...).
+// Returns true if the data came from the cache.
+template <typename T, typename F>
+bool gen_cached(const std::string& key, T* v, unsigned long n, F generate) {
+    std::string path = gen_cache_path(key);
+    GenCacheHeader hdr;
+    // a cache miss is not an error for the caller
+    int saved = errno;
+
+    if (!path.empty()) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (f) {
+            bool hit = fread(&hdr, sizeof(hdr), 1, f) == 1 && memcmp(hdr.magic, "EXPGEN01", 8) == 0
+                       && hdr.value_size == sizeof(T) && hdr.n == n && fread(v, sizeof(T), n, f) == n;
+            fclose(f);
+            errno = saved;
+            if (hit)
+                return true;
+        }
+    }
+
+    generate(v);
+
+    if (!path.empty()) {
+        // written under a temporary name and renamed, so an interrupted run
+        // never leaves a partial file under the real one
+        std::string part = path + ".part";
+        FILE* f = fopen(part.c_str(), "wb");
+        memcpy(hdr.magic, "EXPGEN01", 8);
+        hdr.value_size = sizeof(T);
+        hdr.n = n;
+        bool ok = f && fwrite(&hdr, sizeof(hdr), 1, f) == 1 && fwrite(v, sizeof(T), n, f) == n;
+        ok = f && fclose(f) == 0 && ok;
+        if (ok)
+            rename(part.c_str(), path.c_str());
+        else
+            remove(part.c_str());
+    }
+    errno = saved;
+    return false;
+}
+
+#endif //EXPFLOAT_DATAGEN_H
@@ -64,6 +64,11 @@ namespace dr {
     int print( int color, const std::string &str );
     int printf( int color, const char *str, ... );
 
+    // api for the asynchronous backend: lines are queued and written by a
+    // background thread unless async(false) or DRECHO_SYNC=1 in the environment
+    bool async( bool on );
+    void flush();
+
     // api for errors
     std::string get_any_error();
     void clear_errors();
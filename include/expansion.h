@@ -0,0 +1,310 @@
+//
+// Expansion<T, N>: a value type for x = x_1 + x_2 + ... + x_N, with the x_i
+// of type T (float or double), non-overlapping and in decreasing order of
+// magnitude, so truncating to the first M terms gives the best M-term
+// approximation.
+//
+// All operators are built on the error-free two_sum / two_product of
+// expansion_math.h followed by a renormalization; the term loops have
+// compile-time trip counts and are unrolled for each N. two_product is exact
+// for both types: by FMA where there is one, otherwise by Dekker's split with
+// 2^12 + 1 for float and 2^27 + 1 for double.
+//
+// On doubles these are the double-double (106 bits) and quad-double (212
+// bits) types of Hida, Li & Bailey, the first one as precise as __float128
+// (113 bits) to within a few bits but in hardware arithmetic, see
+// DoubleDouble and QuadDouble below.
+//
+
+#ifndef EXPFLOAT_EXPANSION_H
+#define EXPFLOAT_EXPANSION_H
+
+#include <expansion_math.h>
+
+// @brief renormalize the M terms t (roughly in decreasing order of magnitude)
+// into the non-overlapping N-term expansion e; follows Hida, Li & Bailey.
+// t is used as scratch space.
+template <typename T, int M, int N>
+inline void
+renormalize (T* t, T* e) {
+    T s, err;
+    int i, k = 0;
+
+    // bottom-up: t[0] becomes the rounded sum, t[1..] the exact errors
+    EXP_UNROLL
+    for (i = M-1; i > 0; --i)
+        two_sum(t[i-1], t[i], t[i-1], t[i]);
+
+    // top-down: peel off non-overlapping terms
+    s = t[0];
+    EXP_UNROLL
+    for (i = 1; i < M && k < N-1; ++i) {
+        two_sum(s, t[i], s, err);
+        if (err != 0) {
+            e[k++] = s;
+            s = err;
+        }
+    }
+    // whatever did not fit is folded into the last term
+    EXP_UNROLL
+    for (; i < M; ++i)
+        s += t[i];
+
+    e[k++] = s;
+    for (; k < N; ++k)
+        e[k] = 0;
+}
+
+// @brief two_sum for |a| >= |b|, in three flops
+template <typename T>
+inline void
+quick_two_sum (T a, T b, T& x, T& y) {
+    x = a + b;
+    y = b - (x - a);
+}
+
+template <typename T, int N>
+struct Expansion {
+    static_assert(N >= 2 && N <= 8, "Expansion<T, N> supports 2 to 8 terms");
+
+    T x[N];
+
+    Expansion() {
+        EXP_UNROLL
+        for (int i = 0; i < N; ++i)
+            x[i] = 0;
+    }
+
+    Expansion(T a) {
+        x[0] = a;
+        EXP_UNROLL
+        for (int i = 1; i < N; ++i)
+            x[i] = 0;
+    }
+
+    T  operator[] (int i) const { return x[i]; }
+    T& operator[] (int i)       { return x[i]; }
+
+    // @brief the leading M terms; M > N pads with zeros
+    template <int M>
+    Expansion<T, M> truncate() const {
+        Expansion<T, M> r;
+        EXP_UNROLL
+        for (int i = 0; i < (M < N ? M : N); ++i)
+            r.x[i] = x[i];
+        return r;
+    }
+
+    // @brief the sum of the terms in U, smallest first
+    template <typename U>
+    U value() const {
+        U v = x[N-1];
+        EXP_UNROLL
+        for (int i = N-2; i >= 0; --i)
+            v += x[i];
+        return v;
+    }
+
+    Expansion operator- () const {
+        Expansion r;
+        EXP_UNROLL
+        for (int i = 0; i < N; ++i)
+            r.x[i] = -x[i];
+        return r;
+    }
+
+    Expansion& operator+= (T b) {
+        // two terms (here and below): the double-double operations of Hida,
+        // Li & Bailey, which need no renormalization and have no branches
+        if (N == 2) {
+            T s, e;
+            two_sum(x[0], b, s, e);
+            quick_two_sum(s, e + x[1], x[0], x[1]);
+            return *this;
+        }
+
+        T t[N+1];
+        EXP_UNROLL
+        for (int i = 0; i < N; ++i)
+            t[i] = x[i];
+        t[N] = b;
+        renormalize<T, N+1, N>(t, x);
+        return *this;
+    }
+
+    Expansion& operator+= (const Expansion& b) {
+        if (N == 2) {
+            T s, e, t, f;
+            two_sum(x[0], b.x[0], s, e);
+            two_sum(x[1], b.x[1], t, f);
+            quick_two_sum(s, e + t, s, e);
+            quick_two_sum(s, e + f, x[0], x[1]);
+            return *this;
+        }
+
+        T t[2*N];
+        EXP_UNROLL
+        for (int i = 0; i < N; ++i) {
+            t[2*i]   = x[i];
+            t[2*i+1] = b.x[i];
+        }
+        renormalize<T, 2*N, N>(t, x);
+        return *this;
+    }
+
+    Expansion& operator-= (T b)                { return *this += -b; }
+    Expansion& operator-= (const Expansion& b) { return *this += -b; }
+
+    Expansion& operator*= (T b) {
+        if (N == 2) {
+            T p, e;
+            two_product(x[0], b, p, e);
+            quick_two_sum(p, e + x[1] * b, x[0], x[1]);
+            return *this;
+        }
+
+        T t[2*N];
+        EXP_UNROLL
+        for (int i = 0; i < N; ++i)
+            two_product(x[i], b, t[2*i], t[2*i+1]);
+        renormalize<T, 2*N, N>(t, x);
+        return *this;
+    }
+
+    // products x_i*y_j with i+j < N are formed exactly, those with i+j == N
+    // only rounded, everything smaller is dropped; the terms are emitted in
+    // order of i+j so renormalize sees them roughly sorted.
+    Expansion& operator*= (const Expansion& b) {
+        // two terms: only x_0*y_0 is needed exactly, the cross products go
+        // into its error (Dekker's mul2)
+        if (N == 2) {
+            T p, e;
+            two_product(x[0], b.x[0], p, e);
+            quick_two_sum(p, e + (x[0] * b.x[1] + x[1] * b.x[0]), x[0], x[1]);
+            return *this;
+        }
+
+        const int M = N*(N+1) + N-1;
+        T hi[N][N], lo[N][N], t[M];
+        int i, j, l, k = 0;
+
+        EXP_UNROLL
+        for (i = 0; i < N; ++i)
+            EXP_UNROLL
+            for (j = 0; j < N-i; ++j)
+                two_product(x[i], b.x[j], hi[i][j], lo[i][j]);
+
+        EXP_UNROLL
+        for (l = 0; l <= N; ++l) {
+            EXP_UNROLL
+            for (i = 0; i <= l && l < N; ++i)
+                t[k++] = hi[i][l-i];
+            EXP_UNROLL
+            for (i = 0; i < l; ++i)
+                t[k++] = lo[i][l-1-i];
+        }
+        EXP_UNROLL
+        for (i = 1; i < N; ++i)
+            t[k++] = x[i] * b.x[N-i];
+
+        renormalize<T, M, N>(t, x);
+        return *this;
+    }
+};
+
+template <typename T, int N>
+inline Expansion<T, N> operator+ (Expansion<T, N> a, const Expansion<T, N>& b) { return a += b; }
+template <typename T, int N>
+inline Expansion<T, N> operator+ (Expansion<T, N> a, T b) { return a += b; }
+template <typename T, int N>
+inline Expansion<T, N> operator+ (T a, Expansion<T, N> b) { return b += a; }
+
+template <typename T, int N>
+inline Expansion<T, N> operator- (Expansion<T, N> a, const Expansion<T, N>& b) { return a -= b; }
+template <typename T, int N>
+inline Expansion<T, N> operator- (Expansion<T, N> a, T b) { return a -= b; }
+template <typename T, int N>
+inline Expansion<T, N> operator- (T a, const Expansion<T, N>& b) { return -b + a; }
+
+template <typename T, int N>
+inline Expansion<T, N> operator* (Expansion<T, N> a, const Expansion<T, N>& b) { return a *= b; }
+template <typename T, int N>
+inline Expansion<T, N> operator* (Expansion<T, N> a, T b) { return a *= b; }
+template <typename T, int N>
+inline Expansion<T, N> operator* (T a, Expansion<T, N> b) { return b *= a; }
+
+// ---- division and square root -----------------------------------------------
+//
+// Newton iteration from the T estimate of the leading terms, which is good to
+// the precision p of T; every step in N-term arithmetic doubles the number of
+// correct bits, so ceil(log2 N) steps reach the N p bits of the expansion.
+// The last step is Karp and Markstein's: it takes the multiplication by the
+// numerator (or radicand) into the correction, so the reciprocal itself is
+// only needed to half the precision.
+
+// @brief the Newton steps from p to N p bits, ceil(log2 N)
+template <int N>
+struct exp_newton_steps { enum { value = 1 + exp_newton_steps<(N + 1) / 2>::value }; };
+template <>
+struct exp_newton_steps<1> { enum { value = 0 }; };
+
+// @brief 1 / b; an infinity for b == 0
+template <typename T, int N>
+inline Expansion<T, N> reciprocal (const Expansion<T, N>& b) {
+    Expansion<T, N> y(T(1) / b.x[0]);
+    if (b.x[0] == 0)
+        return y;
+    for (int k = 0; k < exp_newton_steps<N>::value; ++k)
+        y += y * (T(1) - b * y);
+    return y;
+}
+
+template <typename T, int N>
+inline Expansion<T, N> operator/ (const Expansion<T, N>& a, const Expansion<T, N>& b) {
+    Expansion<T, N> y(T(1) / b.x[0]);
+    if (b.x[0] == 0)
+        return Expansion<T, N>(a.x[0] / b.x[0]);
+    for (int k = 1; k < exp_newton_steps<N>::value; ++k)
+        y += y * (T(1) - b * y);
+    Expansion<T, N> q = a * y;
+    return q + y * (a - b * q);
+}
+template <typename T, int N>
+inline Expansion<T, N> operator/ (const Expansion<T, N>& a, T b) { return a / Expansion<T, N>(b); }
+template <typename T, int N>
+inline Expansion<T, N> operator/ (T a, const Expansion<T, N>& b) { return Expansion<T, N>(a) / b; }
+
+template <typename T, int N>
+inline Expansion<T, N>& operator/= (Expansion<T, N>& a, const Expansion<T, N>& b) { return a = a / b; }
+template <typename T, int N>
+inline Expansion<T, N>& operator/= (Expansion<T, N>& a, T b) { return a = a / b; }
+
+// @brief the square root, from Newton steps on 1/sqrt(a); 0 for a == 0 and
+// NaN for a < 0, as sqrt(T)
+template <typename T, int N>
+inline Expansion<T, N> sqrt (const Expansion<T, N>& a) {
+    if (!(a.x[0] > 0))
+        return Expansion<T, N>(sqrt(a.x[0]));
+    Expansion<T, N> y(T(1) / sqrt(a.x[0]));
+    for (int k = 1; k < exp_newton_steps<N>::value; ++k)
+        y += y * (T(1) - a * y * y) * T(0.5);
+    Expansion<T, N> s = a * y;
+    return s + (a - s * s) * y * T(0.5);
+}
+
+typedef Expansion<double, 2> DoubleDouble;
+typedef Expansion<double, 4> QuadDouble;
+
+// @brief split a wider value (double, __float128) into an N-term expansion
+template <typename T, int N, typename U>
+inline Expansion<T, N> to_expansion (U v) {
+    Expansion<T, N> r;
+    EXP_UNROLL
+    for (int i = 0; i < N; ++i) {
+        r.x[i] = static_cast<T>(v);
+        v -= r.x[i];
+    }
+    return r;
+}
+
+#endif //EXPFLOAT_EXPANSION_H
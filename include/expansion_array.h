@@ -0,0 +1,196 @@
+//
+// ExpansionArray<T, N>: n expansions of N terms stored as structure of
+// arrays, i.e. every term level in its own aligned, contiguous stream. The
+// leading stream is allocated up front, the lower ones only when something
+// writes to them; until then they read as zero. term(0) is a plain T array,
+// so float-only consumers can use the leading terms without a copy.
+//
+
+#ifndef EXPFLOAT_EXPANSION_ARRAY_H
+#define EXPFLOAT_EXPANSION_ARRAY_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include <expansion_math.h>
+#include <expansion_simd.h>
+#include <expansion.h>
+#include <expansion_dispatch.h>
+
+#define EXP_ALIGN 64
+
+template <typename T>
+inline T* exp_aligned_alloc (unsigned long n) {
+    void* p = NULL;
+    if (posix_memalign(&p, EXP_ALIGN, n * sizeof(T)) != 0)
+        throw std::bad_alloc();
+    return static_cast<T*>(p);
+}
+
+template <typename T, int N>
+class ExpansionArray {
+public:
+    explicit ExpansionArray(unsigned long n) : m_n(n) {
+        for (int k = 0; k < N; ++k)
+            m_terms[k] = NULL;
+        m_terms[0] = exp_aligned_alloc<T>(n);
+        memset(m_terms[0], 0, n * sizeof(T));
+    }
+
+    ExpansionArray(ExpansionArray&& o) : m_n(o.m_n) {
+        for (int k = 0; k < N; ++k) {
+            m_terms[k] = o.m_terms[k];
+            o.m_terms[k] = NULL;
+        }
+        o.m_n = 0;
+    }
+
+    ExpansionArray(const ExpansionArray&) = delete;
+    ExpansionArray& operator= (const ExpansionArray&) = delete;
+
+    ~ExpansionArray() {
+        for (int k = 0; k < N; ++k)
+            free(m_terms[k]);
+    }
+
+    unsigned long size() const { return m_n; }
+
+    // @brief the k-th term of every element, allocated (as zeros) on first use
+    T* term(int k) {
+        if (m_terms[k] == NULL) {
+            m_terms[k] = exp_aligned_alloc<T>(m_n);
+            memset(m_terms[k], 0, m_n * sizeof(T));
+        }
+        return m_terms[k];
+    }
+
+    // @brief the k-th term stream, or NULL if it was never written
+    const T* term(int k) const { return m_terms[k]; }
+
+    bool has_term(int k) const { return m_terms[k] != NULL; }
+
+    // @brief zero-copy view of the leading terms
+    T*       top()       { return m_terms[0]; }
+    const T* top() const { return m_terms[0]; }
+
+    // @brief release the lower term streams, truncating every element to its leading term
+    void truncate() {
+        for (int k = 1; k < N; ++k) {
+            free(m_terms[k]);
+            m_terms[k] = NULL;
+        }
+    }
+
+    Expansion<T, N> get(unsigned long i) const {
+        Expansion<T, N> e;
+        for (int k = 0; k < N; ++k)
+            e.x[k] = m_terms[k] ? m_terms[k][i] : T(0);
+        return e;
+    }
+
+    void set(unsigned long i, const Expansion<T, N>& e) {
+        for (int k = 0; k < N; ++k)
+            if (m_terms[k] || e.x[k] != 0)
+                term(k)[i] = e.x[k];
+    }
+
+    void fill(T v) {
+        truncate();
+        for (unsigned long i = 0; i < m_n; ++i)
+            m_terms[0][i] = v;
+    }
+
+    // @brief x[i] += b[i]
+    void add(const T* b);
+    // @brief x[i] *= a
+    void scale(T a);
+    // @brief x[i] = a * x[i] + b[i]
+    void daxpy(T a, const T* b);
+    // @brief x[i] /= b[i]
+    void div(const ExpansionArray& b);
+    // @brief x[i] = 1 / x[i]
+    void reciprocal();
+    // @brief x[i] = sqrt(x[i])
+    void sqrt();
+
+private:
+    unsigned long m_n;
+    T* m_terms[N];
+};
+
+template <typename T, int N>
+inline void ExpansionArray<T, N>::add(const T* b) {
+    for (int k = 1; k < N; ++k)
+        term(k);
+    for (unsigned long i = 0; i < m_n; ++i)
+        set(i, get(i) + b[i]);
+}
+
+template <typename T, int N>
+inline void ExpansionArray<T, N>::scale(T a) {
+    for (int k = 1; k < N; ++k)
+        term(k);
+    for (unsigned long i = 0; i < m_n; ++i)
+        set(i, get(i) * a);
+}
+
+template <typename T, int N>
+inline void ExpansionArray<T, N>::daxpy(T a, const T* b) {
+    for (int k = 1; k < N; ++k)
+        term(k);
+    for (unsigned long i = 0; i < m_n; ++i)
+        set(i, get(i) * a + b[i]);
+}
+
+template <typename T, int N>
+inline void ExpansionArray<T, N>::div(const ExpansionArray& b) {
+    for (int k = 1; k < N; ++k)
+        term(k);
+    for (unsigned long i = 0; i < m_n; ++i)
+        set(i, get(i) / b.get(i));
+}
+
+// the free reciprocal and sqrt of expansion.h, which the members of the same
+// name hide; not as ::reciprocal, so that this header also builds inside the
+// per-ISA namespaces of src/expansion_isa.cpp
+template <typename T, int N>
+inline Expansion<T, N> exp_array_reciprocal (const Expansion<T, N>& a) { return reciprocal(a); }
+
+template <typename T, int N>
+inline Expansion<T, N> exp_array_sqrt (const Expansion<T, N>& a) { return sqrt(a); }
+
+template <typename T, int N>
+inline void ExpansionArray<T, N>::reciprocal() {
+    for (int k = 1; k < N; ++k)
+        term(k);
+    for (unsigned long i = 0; i < m_n; ++i)
+        set(i, exp_array_reciprocal(get(i)));
+}
+
+template <typename T, int N>
+inline void ExpansionArray<T, N>::sqrt() {
+    for (int k = 1; k < N; ++k)
+        term(k);
+    for (unsigned long i = 0; i < m_n; ++i)
+        set(i, exp_array_sqrt(get(i)));
+}
+
+// two-term float arrays use the batched kernels selected by exp_kernels()
+
+template <>
+inline void ExpansionArray<float, 2>::add(const float* b) {
+    exp_kernels().grow_expansion_array(m_terms[0], term(1), b, m_n);
+}
+
+template <>
+inline void ExpansionArray<float, 2>::scale(float a) {
+    exp_kernels().scale_expansion_array(m_terms[0], term(1), a, m_n);
+}
+
+template <>
+inline void ExpansionArray<float, 2>::daxpy(float a, const float* b) {
+    exp_kernels().daxpy_array(m_terms[0], term(1), a, b, m_n);
+}
+
+#endif //EXPFLOAT_EXPANSION_ARRAY_H
@@ -0,0 +1,263 @@
+//
+// Dense linear algebra in expansion form: A and x are plain floats, the result
+// is kept as the two-term expansion (y1, y2).
+//
+
+#ifndef EXPFLOAT_EXPANSION_BLAS_H
+#define EXPFLOAT_EXPANSION_BLAS_H
+
+#include <algorithm>
+#include <vector>
+
+#include <expansion_math.h>
+#include <expansion_simd.h>
+#include <expansion.h>
+#include <expansion_parallel.h>
+#include <expansion_dispatch.h>
+
+enum exp_layout {
+    EXP_ROW_MAJOR,
+    EXP_COL_MAJOR
+};
+
+// tile sizes for gemv, in elements. A row tile of (y1, y2) and a column tile
+// of x are 8 KB each, so they stay in L1 while A streams through.
+#define GEMV_TILE_ROWS 1024
+#define GEMV_TILE_COLS 2048
+
+// smallest block of rows handed to a thread
+#define GEMV_TASK_ROWS 16
+
+// @brief rows per parallel task of gemv: about four tasks per thread, in
+// multiples of GEMV_TASK_ROWS, and at most a row tile, so that every task
+// is still one cache block
+inline unsigned int gemv_task_rows (unsigned int m) {
+    unsigned long tasks = 4ul * exp_num_threads();
+    unsigned long rows = (m + tasks - 1) / tasks;
+    rows = (rows + GEMV_TASK_ROWS - 1) / GEMV_TASK_ROWS * GEMV_TASK_ROWS;
+    return (unsigned int)std::max(1ul, std::min(rows, (unsigned long)GEMV_TILE_ROWS));
+}
+
+// @brief y = A x with A an m x n matrix, reference version in T
+template <typename T>
+inline void gemv (exp_layout layout, unsigned int m, unsigned int n, const T* A, const T* x, T* y) {
+    if (layout == EXP_ROW_MAJOR) {
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < (long) m; ++i) {
+            T res = 0.0;
+            for (unsigned int j = 0; j < n; ++j)
+                res += A[i*(unsigned long)n + j] * x[j];
+            y[i] = res;
+        }
+    } else {
+        const unsigned int rows = gemv_task_rows(m);
+        #pragma omp parallel for schedule(static)
+        for (long ib = 0; ib < (long) m; ib += rows) {
+            unsigned int ie = std::min(m, (unsigned int)ib + rows);
+            for (unsigned int i = ib; i < ie; ++i)
+                y[i] = 0.0;
+            for (unsigned int j = 0; j < n; ++j)
+                for (unsigned int i = ib; i < ie; ++i)
+                    y[i] += A[j*(unsigned long)m + i] * x[j];
+        }
+    }
+}
+
+// @brief (y1, y2) = A x with A an m x n matrix; every product is formed with
+// two_product and accumulated with grow_expansion. The row and column kernels
+// are those of exp_kernels(), so the widest ISA of the CPU is used.
+inline void exp_gemv (exp_layout layout, unsigned int m, unsigned int n, const float* A, const float* x,
+                      float* y1, float* y2) {
+    if (layout == EXP_ROW_MAJOR) {
+        // rows are independent; x is reused across a task's rows one column tile at a time
+        const unsigned int rows = gemv_task_rows(m);
+        #pragma omp parallel for schedule(static)
+        for (long ib = 0; ib < (long) m; ib += rows) {
+            unsigned int ie = std::min(m, (unsigned int)ib + rows);
+            float p1, p2;
+
+            for (unsigned int i = ib; i < ie; ++i)
+                y1[i] = y2[i] = 0.0;
+
+            for (unsigned int jb = 0; jb < n; jb += GEMV_TILE_COLS) {
+                unsigned int nj = std::min(n - jb, (unsigned int)GEMV_TILE_COLS);
+                for (unsigned int i = ib; i < ie; ++i) {
+                    exp_kernels().exp_dot(A + i*(unsigned long)n + jb, x + jb, nj, p1, p2);
+                    fast_expansion_sum(y1[i], y2[i], p1, p2);
+                }
+            }
+        }
+    } else {
+        // a task's rows of (y1, y2) stay in cache while all columns are added to them
+        const unsigned int rows = gemv_task_rows(m);
+        #pragma omp parallel for schedule(static)
+        for (long ib = 0; ib < (long) m; ib += rows) {
+            unsigned int ni = std::min(m - (unsigned int)ib, rows);
+
+            for (unsigned int i = 0; i < ni; ++i)
+                y1[ib+i] = y2[ib+i] = 0.0;
+
+            for (unsigned int j = 0; j < n; ++j)
+                exp_kernels().exp_axpy_array(y1 + ib, y2 + ib, A + j*(unsigned long)m + ib, x[j], ni);
+        }
+    }
+}
+
+// gemm blocking: an MC x KC block of A and a KC x NC block of B are packed
+// into contiguous panels (L2 and L3 resident), the micro-kernel keeps an
+// MR x NR tile of C in registers.
+#define GEMM_MR 4
+#define GEMM_NR EXP_SIMD_WIDTH
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4096
+
+// @brief C = A B with A m x k, B k x n and C m x n, all row-major; reference
+// version in T
+template <typename T>
+inline void gemm (unsigned int m, unsigned int n, unsigned int k, const T* A, const T* B, T* C) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long) m; ++i) {
+        T* c = C + i*(unsigned long)n;
+        for (unsigned int j = 0; j < n; ++j)
+            c[j] = 0.0;
+        for (unsigned int p = 0; p < k; ++p) {
+            T a = A[i*(unsigned long)k + p];
+            const T* b = B + p*(unsigned long)n;
+            for (unsigned int j = 0; j < n; ++j)
+                c[j] += a * b[j];
+        }
+    }
+}
+
+// @brief pack an mc x kc block of (A1, A2) into MR-row panels, zero padded
+inline void exp_gemm_pack_a (unsigned int mc, unsigned int kc, const float* A1, const float* A2, unsigned long lda,
+                             float* P1, float* P2) {
+    for (unsigned int ir = 0; ir < mc; ir += GEMM_MR)
+        for (unsigned int p = 0; p < kc; ++p)
+            for (unsigned int r = 0; r < GEMM_MR; ++r) {
+                bool in = ir + r < mc;
+                *P1++ = in ? A1[(ir+r)*lda + p] : 0.0f;
+                *P2++ = in ? A2[(ir+r)*lda + p] : 0.0f;
+            }
+}
+
+// @brief pack a kc x nc block of (B1, B2) into NR-column panels, zero padded
+inline void exp_gemm_pack_b (unsigned int kc, unsigned int nc, const float* B1, const float* B2, unsigned long ldb,
+                             float* P1, float* P2) {
+    #pragma omp parallel for schedule(static)
+    for (long jr = 0; jr < (long) nc; jr += GEMM_NR) {
+        float *p1 = P1 + jr*kc, *p2 = P2 + jr*kc;
+        for (unsigned int p = 0; p < kc; ++p)
+            for (unsigned int c = 0; c < GEMM_NR; ++c) {
+                bool in = jr + c < nc;
+                *p1++ = in ? B1[p*ldb + jr + c] : 0.0f;
+                *p2++ = in ? B2[p*ldb + jr + c] : 0.0f;
+            }
+    }
+}
+
+// @brief (C1, C2) += A B for one mr x nr (<= MR x NR) tile from packed panels.
+// The leading products are formed with two_product and summed with two_sum;
+// their errors and the cross terms a1*b2 + a2*b1 go into a float correction
+// that is folded back in once at the end. a2*b2 is dropped.
+inline void exp_gemm_micro (unsigned int kc, const float* a1, const float* a2, const float* b1, const float* b2,
+                            float* C1, float* C2, unsigned long ldc, unsigned int mr, unsigned int nr) {
+    float c1[GEMM_MR*GEMM_NR], c2[GEMM_MR*GEMM_NR];
+    vfloat s[GEMM_MR], t[GEMM_MR];
+    unsigned int r, c;
+
+    for (r = 0; r < GEMM_MR; ++r)
+        for (c = 0; c < GEMM_NR; ++c) {
+            bool in = r < mr && c < nr;
+            c1[r*GEMM_NR + c] = in ? C1[r*ldc + c] : 0.0f;
+            c2[r*GEMM_NR + c] = in ? C2[r*ldc + c] : 0.0f;
+        }
+
+    EXP_UNROLL
+    for (r = 0; r < GEMM_MR; ++r) {
+        s[r] = v_load(c1 + r*GEMM_NR);
+        t[r] = v_load(c2 + r*GEMM_NR);
+    }
+
+    for (unsigned int p = 0; p < kc; ++p) {
+        vfloat vb1 = v_load(b1 + p*GEMM_NR), vb2 = v_load(b2 + p*GEMM_NR);
+        EXP_UNROLL
+        for (r = 0; r < GEMM_MR; ++r) {
+            vfloat va1 = v_set1(a1[p*GEMM_MR + r]), va2 = v_set1(a2[p*GEMM_MR + r]), x, y, e;
+
+            v_two_product(va1, vb1, x, y);
+            v_two_sum(s[r], x, s[r], e);
+            t[r] = v_add(t[r], v_add(v_add(e, y), v_add(v_mul(va1, vb2), v_mul(va2, vb1))));
+        }
+    }
+
+    EXP_UNROLL
+    for (r = 0; r < GEMM_MR; ++r) {
+        v_quick_two_sum(s[r], t[r], s[r], t[r]);
+        v_store(c1 + r*GEMM_NR, s[r]);
+        v_store(c2 + r*GEMM_NR, t[r]);
+    }
+
+    for (r = 0; r < mr; ++r)
+        for (c = 0; c < nr; ++c) {
+            C1[r*ldc + c] = c1[r*GEMM_NR + c];
+            C2[r*ldc + c] = c2[r*GEMM_NR + c];
+        }
+}
+
+// @brief (C1, C2) = (A1, A2) (B1, B2) with A m x k, B k x n and C m x n, all
+// row-major expansions. B is packed once per (jc, pc) block and shared, the
+// MC row blocks of A are packed and multiplied by the threads in parallel.
+// This is the kernel of one ISA build, see exp_gemm.
+inline void exp_gemm_simd (unsigned int m, unsigned int n, unsigned int k,
+                           const float* A1, const float* A2, const float* B1, const float* B2, float* C1, float* C2) {
+    std::vector<float> Bp1((unsigned long)GEMM_KC * GEMM_NC), Bp2((unsigned long)GEMM_KC * GEMM_NC);
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long) m; ++i)
+        for (unsigned int j = 0; j < n; ++j)
+            C1[i*(unsigned long)n + j] = C2[i*(unsigned long)n + j] = 0.0f;
+
+    for (unsigned int jc = 0; jc < n; jc += GEMM_NC) {
+        unsigned int nc = std::min(n - jc, (unsigned int)GEMM_NC);
+
+        for (unsigned int pc = 0; pc < k; pc += GEMM_KC) {
+            unsigned int kc = std::min(k - pc, (unsigned int)GEMM_KC);
+
+            exp_gemm_pack_b(kc, nc, B1 + pc*(unsigned long)n + jc, B2 + pc*(unsigned long)n + jc, n,
+                            Bp1.data(), Bp2.data());
+
+            #pragma omp parallel
+            {
+                std::vector<float> Ap1(GEMM_MC * GEMM_KC), Ap2(GEMM_MC * GEMM_KC);
+
+                #pragma omp for schedule(dynamic)
+                for (long ic = 0; ic < (long) m; ic += GEMM_MC) {
+                    unsigned int mc = std::min(m - (unsigned int)ic, (unsigned int)GEMM_MC);
+
+                    exp_gemm_pack_a(mc, kc, A1 + ic*(unsigned long)k + pc, A2 + ic*(unsigned long)k + pc, k,
+                                    Ap1.data(), Ap2.data());
+
+                    for (unsigned int jr = 0; jr < nc; jr += GEMM_NR)
+                        for (unsigned int ir = 0; ir < mc; ir += GEMM_MR) {
+                            unsigned long off = (ic + ir)*(unsigned long)n + jc + jr;
+                            exp_gemm_micro(kc, Ap1.data() + ir*kc, Ap2.data() + ir*kc,
+                                           Bp1.data() + jr*kc, Bp2.data() + jr*kc,
+                                           C1 + off, C2 + off, n,
+                                           std::min(mc - ir, (unsigned int)GEMM_MR),
+                                           std::min(nc - jr, (unsigned int)GEMM_NR));
+                        }
+                }
+            }
+        }
+    }
+}
+
+// @brief exp_gemm_simd of the kernels selected for this CPU
+inline void exp_gemm (unsigned int m, unsigned int n, unsigned int k,
+                      const float* A1, const float* A2, const float* B1, const float* B2, float* C1, float* C2) {
+    exp_kernels().exp_gemm(m, n, k, A1, A2, B1, B2, C1, C2);
+}
+
+#endif //EXPFLOAT_EXPANSION_BLAS_H
@@ -0,0 +1,66 @@
+//
+// Runtime CPU dispatch of the batched expansion kernels.
+//
+// The build has no -march, so expansion_simd.h on its own compiles to its
+// scalar fallback. src/expansion_isa.cpp is compiled once per instruction set
+// (scalar, SSE4.1, AVX2, AVX2 + FMA, AVX-512) with the matching flags, each
+// copy in its own namespace, and exports a table of its kernels. At the first
+// call exp_kernels() picks the widest table the CPU supports; EXPFLOAT_ISA
+// (scalar, sse41, avx2, avx2fma or avx512) overrides the choice, e.g. for
+// benchmarking, and falls back to the default if the CPU cannot run it.
+//
+// exp_gemv and exp_gemm (expansion_blas.h), the ExpansionArray<float, 2>
+// fast paths and the LSRK45Exp stage update (test_apps.h) go through the
+// table as well; only code that calls expansion_simd.h directly is limited
+// to the ISA of the build, i.e. scalar unless EXPFLOAT_NATIVE is set.
+//
+
+#ifndef EXPFLOAT_EXPANSION_DISPATCH_H
+#define EXPFLOAT_EXPANSION_DISPATCH_H
+
+enum exp_isa {
+    EXP_ISA_SCALAR, EXP_ISA_SSE41, EXP_ISA_AVX2, EXP_ISA_AVX2FMA, EXP_ISA_AVX512,
+    EXP_NUM_ISAS
+};
+
+struct ExpKernels {
+    exp_isa isa;
+    const char* name;
+    int width;      // EXP_SIMD_WIDTH of this build
+    bool fma;       // two_product uses FMA, otherwise Dekker's split
+
+    void (*two_sum_array)(const float* a, const float* b, float* x, float* y, unsigned long n);
+    void (*fast_two_sum_array)(const float* a, const float* b, float* x, float* y, unsigned long n);
+    void (*two_product_array)(const float* a, const float* b, float* x, float* y, unsigned long n);
+    void (*grow_expansion_array)(float* e1, float* e2, const float* b, unsigned long n);
+    void (*fast_expansion_sum_array)(float* e1, float* e2, const float* f1, const float* f2, unsigned long n);
+    void (*scale_expansion_array)(float* e1, float* e2, float a, unsigned long n);
+    void (*daxpy_array)(float* e1, float* e2, float a, const float* b, unsigned long n);
+    void (*exp_axpy_array)(float* e1, float* e2, const float* a, float s, unsigned long n);
+    void (*exp_sum)(const float* a, unsigned long n, float& r1, float& r2);
+    void (*exp_dot)(const float* a, const float* b, unsigned long n, float& r1, float& r2);
+    void (*horner_array)(const float* a, int degree, const float* x, float* y, unsigned long n);
+    void (*comp_horner_array)(const float* a, int degree, const float* x, float* r1, float* r2, unsigned long n);
+    void (*exp_gemm)(unsigned int m, unsigned int n, unsigned int k, const float* A1, const float* A2,
+                     const float* B1, const float* B2, float* C1, float* C2);
+    void (*lsrk_update)(float* q1, float* q2, float* r1, float* r2, const float* rhs, float a, float b, float dt,
+                        unsigned long n);
+};
+
+// @brief the kernels for isa, or NULL if they were not built or the CPU
+// cannot run them
+const ExpKernels* exp_kernels_for(exp_isa isa);
+
+// @brief the kernels selected for this CPU (and EXPFLOAT_ISA), chosen once
+const ExpKernels& exp_kernels();
+
+// @brief check the kernels of k against the scalar ones on n random elements:
+// element-wise kernels, lsrk_update and exp_gemm must match bitwise, as
+// two_product is exact with or without FMA; reductions must be within
+// n 2^-44 of the exact result relative to sum |a_i|, compensated Horner
+// within its error bound (see comp_horner) of the exact p(x[i]). Returns the
+// number of failing kernels and the largest relative reduction error in
+// max_err.
+int exp_kernels_check(const ExpKernels& k, unsigned long n, double& max_err);
+
+#endif //EXPFLOAT_EXPANSION_DISPATCH_H
@@ -0,0 +1,582 @@
+//
+// Elementary functions of expansions: exp, log, sin and cos of
+// Expansion<T, N>, one at a time and batched over ExpansionArray.
+//
+// The argument is reduced in expansion arithmetic with M = min(2 N, 8)
+// terms, against ln 2 and pi held to B = min(M p, 212) bits (p the precision
+// of T, so B = 212 for double, 96 for float-float), and then goes through a
+// polynomial whose degree depends on T and N only (ExpPoly):
+//
+//   exp:  a = k ln 2 + 2^9 s, expm1(s) by Horner, squared back up 9 times
+//         as expm1(2x) = expm1(x) (2 + expm1(x)), and scaled by 2^k
+//   sin,  a = k pi/2 + j pi/8 + t with |t| <= pi/16; sin(t) and cos(t) by
+//   cos:  Horner in t^2, combined with a table of sin(j pi/8), cos(j pi/8)
+//         and the quadrant k
+//   log:  a = 2^e m with m in [sqrt(1/2), sqrt(2)), log m = 2 atanh(z) for
+//         z = (m - 1) / (m + 1), by Horner in z^2; unlike Newton steps on
+//         exp this keeps its relative accuracy for a close to 1
+//
+// Every element takes the same number of steps whatever its value; only
+// zeros, infinities, NaNs and out of range arguments branch off at the top.
+// The reductions lose nothing for |a| up to 2^(B - N p): 2^106 for double-
+// double, 2^48 for float-float, 1 for quad-double. sin and cos are NaN from
+// 2^(B - p) on, where fewer than p bits of the reduced argument are left.
+// Two-term arrays go through the same steps a block of elements at a time.
+//
+
+#ifndef EXPFLOAT_EXPANSION_ELEMENTARY_H
+#define EXPFLOAT_EXPANSION_ELEMENTARY_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <expansion.h>
+#include <expansion_array.h>
+
+// the reduced argument of exp is divided by 2^EXP_SQUARINGS
+#define EXP_SQUARINGS 9
+
+// elements per step of the batched two-term functions
+#define EXP_ELEM_BLOCK 64
+
+// ln 2 and pi as four non-overlapping doubles
+static const double exp_ln2_parts[4] = {
+    6.931471805599452862e-01, 2.319046813846299558e-17, 5.707708438416212066e-34, -3.582432210601811423e-50
+};
+static const double exp_pi_parts[4] = {
+    3.141592653589793116e+00, 1.224646799147353207e-16, -2.994769809718339666e-33, 1.112454220863365282e-49
+};
+
+// @brief the M-term expansion of a four-double constant, times scale (a power of 2)
+template <typename T, int M>
+inline Expansion<T, M> exp_constant (const double* parts, double scale = 1.0) {
+    Expansion<T, M> e;
+    for (int i = 3; i >= 0; --i)
+        e += to_expansion<T, M>(parts[i] * scale);
+    return e;
+}
+
+// @brief sum c_n y^n for |y| <= bound, to N p bits. Horner's rule runs in T
+// while the terms are below 2^-((N-1) p) of the value, which is most of them,
+// and in N-term arithmetic for the leading ones only.
+template <typename T, int N>
+struct ExpPoly {
+    std::vector<Expansion<T, N> > c;
+    std::vector<T> ct;
+    int split;      // c_n for n >= split in T
+
+    // @brief keep the coefficients of coef that matter for |y| <= bound;
+    // coef has to run past the last of them
+    void init(const std::vector<Expansion<T, N> >& coef, double bound) {
+        int bits = N * std::numeric_limits<T>::digits, low = (N - 1) * std::numeric_limits<T>::digits;
+
+        c.clear();
+        ct.clear();
+        split = -1;
+        for (size_t n = 0; n < coef.size(); ++n) {
+            double lg = log2(fabs((double)coef[n].x[0])) + n * log2(bound);
+            if (lg < -bits - 2)
+                break;
+            if (split < 0 && lg < -low)
+                split = n;
+            c.push_back(coef[n]);
+            ct.push_back(coef[n].x[0]);
+        }
+        if (split < 0)
+            split = c.size();
+    }
+
+    Expansion<T, N> operator() (const Expansion<T, N>& y) const {
+        int deg = (int)c.size() - 1, n = deg;
+        T pt = 0;
+
+        if (split <= deg)
+            for (pt = ct[n--]; n >= split; --n)
+                pt = pt * y.x[0] + ct[n];
+        Expansion<T, N> p(pt);
+        for (; n >= 0; --n)
+            p = p * y + c[n];
+        return p;
+    }
+
+    // @brief p[i] = (*this)(y[i]) for i < n <= EXP_ELEM_BLOCK, one
+    // coefficient at a time across all of them, so the loops vectorize
+    void eval (const Expansion<T, N>* y, Expansion<T, N>* p, int n) const {
+        int deg = (int)c.size() - 1, k = deg, i;
+        T pt[EXP_ELEM_BLOCK];
+
+        for (i = 0; i < n; ++i)
+            pt[i] = 0;
+        if (split <= deg) {
+            for (i = 0; i < n; ++i)
+                pt[i] = ct[k];
+            for (--k; k >= split; --k)
+                for (i = 0; i < n; ++i)
+                    pt[i] = pt[i] * y[i].x[0] + ct[k];
+        }
+        for (i = 0; i < n; ++i)
+            p[i] = Expansion<T, N>(pt[i]);
+        for (; k >= 0; --k)
+            for (i = 0; i < n; ++i)
+                p[i] = p[i] * y[i] + c[k];
+    }
+};
+
+// @brief everything the functions of Expansion<T, N> share, set up once
+template <typename T, int N>
+struct ExpElementary {
+    enum { M = 2*N < 8 ? 2*N : 8 };
+    // bits of the constants below
+    enum { B = M * std::numeric_limits<T>::digits < 212 ? M * std::numeric_limits<T>::digits : 212 };
+
+    Expansion<T, M> ln2, pi_2, pi_8;
+    // expm1(s) / s, sin(t) / t and cos(t) in t^2, atanh(z) / z in z^2
+    ExpPoly<T, N> exp_poly, sin_poly, cos_poly, log_poly;
+    Expansion<T, N> sin_tab[3], cos_tab[3];     // of j pi/8
+
+    static const ExpElementary& get() {
+        static ExpElementary st;
+        return st;
+    }
+
+    ExpElementary() {
+        int bits = N * std::numeric_limits<T>::digits;
+        double zmax = 3 - 2 * M_SQRT2;
+        std::vector<Expansion<T, N> > f(1, Expansion<T, N>(T(1))), ce, cs, cc, cl;
+
+        ln2 = exp_constant<T, M>(exp_ln2_parts);
+        pi_2 = exp_constant<T, M>(exp_pi_parts, 0.5);
+        pi_8 = exp_constant<T, M>(exp_pi_parts, 0.125);
+
+        // 1/n! as far as (pi/16)^n / n! matters, and a few more
+        for (double lg = 0; lg > -bits - 16; ) {
+            f.push_back(f.back() / T(f.size()));
+            lg += log2(M_PI / 16) - log2((double)f.size() - 1);
+        }
+        for (size_t n = 0; n + 1 < f.size(); ++n)
+            ce.push_back(f[n + 1]);
+        for (size_t k = 0; 2*k + 1 < f.size(); ++k) {
+            cs.push_back(k % 2 ? -f[2*k + 1] : f[2*k + 1]);
+            cc.push_back(k % 2 ? -f[2*k] : f[2*k]);
+        }
+        for (int k = 0; (2*k - 1) * log2(zmax) > -bits - 16; ++k)
+            cl.push_back(T(1) / Expansion<T, N>(T(2*k + 1)));
+
+        exp_poly.init(ce, 0.35 / (1 << EXP_SQUARINGS));
+        sin_poly.init(cs, (M_PI / 16) * (M_PI / 16));
+        cos_poly.init(cc, (M_PI / 16) * (M_PI / 16));
+        log_poly.init(cl, zmax * zmax);
+
+        // half-angle formulas from cos(pi/4) = sqrt(1/2)
+        Expansion<T, N> c4 = sqrt(Expansion<T, N>(T(0.5)));
+        sin_tab[0] = T(0);
+        cos_tab[0] = T(1);
+        sin_tab[1] = sqrt((T(1) - c4) * T(0.5));
+        cos_tab[1] = sqrt((c4 + T(1)) * T(0.5));
+        sin_tab[2] = c4;
+        cos_tab[2] = c4;
+    }
+};
+
+template <typename T, int N>
+inline Expansion<T, N> exp (const Expansion<T, N>& a) {
+    const ExpElementary<T, N>& c = ExpElementary<T, N>::get();
+    const int M = ExpElementary<T, N>::M;
+    T a0 = a.x[0];
+    // beyond these e^a is inf or rounds to 0 in T
+    T hi = std::numeric_limits<T>::max_exponent * T(M_LN2);
+    T lo = (std::numeric_limits<T>::min_exponent - std::numeric_limits<T>::digits - 1) * T(M_LN2);
+
+    if (a0 != a0)
+        return a;
+    if (a0 > hi)
+        return Expansion<T, N>(std::numeric_limits<T>::infinity());
+    if (a0 < lo)
+        return Expansion<T, N>();
+
+    T k = floor(a0 / c.ln2.x[0] + T(0.5));
+    Expansion<T, N> s = (a.template truncate<M>() - c.ln2 * k).template truncate<N>() * T(1.0 / (1 << EXP_SQUARINGS));
+
+    Expansion<T, N> p = c.exp_poly(s) * s;
+    for (int i = 0; i < EXP_SQUARINGS; ++i)
+        p = p * (p + T(2));
+    p += T(1);
+
+    for (int i = 0; i < N; ++i)
+        p.x[i] = ldexp(p.x[i], (int)k);
+    return p;
+}
+
+// @brief the natural logarithm; -inf for 0 and NaN for a < 0, as log(T)
+template <typename T, int N>
+inline Expansion<T, N> log (const Expansion<T, N>& a) {
+    const ExpElementary<T, N>& c = ExpElementary<T, N>::get();
+    T a0 = a.x[0];
+    int e;
+
+    if (!(a0 > 0) || a0 == std::numeric_limits<T>::infinity())
+        return Expansion<T, N>(log(a0));
+
+    if (frexp(a0, &e) < T(M_SQRT1_2))
+        --e;
+    Expansion<T, N> m = a;
+    for (int i = 0; i < N; ++i)
+        m.x[i] = ldexp(m.x[i], -e);
+
+    Expansion<T, N> z = (m - T(1)) / (m + T(1));
+
+    return (c.ln2 * T(e)).template truncate<N>() + z * c.log_poly(z * z) * T(2);
+}
+
+// @brief sin(t) and cos(t) for |t| <= pi/16
+template <typename T, int N>
+inline void sincos_kernel (const Expansion<T, N>& t, Expansion<T, N>& s, Expansion<T, N>& c) {
+    const ExpElementary<T, N>& e = ExpElementary<T, N>::get();
+    Expansion<T, N> t2 = t * t;
+
+    s = e.sin_poly(t2) * t;
+    c = e.cos_poly(t2);
+}
+
+// @brief sin(a) and cos(a) at once; NaN for infinite, NaN or too large a
+template <typename T, int N>
+inline void sincos (const Expansion<T, N>& a, Expansion<T, N>& s, Expansion<T, N>& c) {
+    const ExpElementary<T, N>& e = ExpElementary<T, N>::get();
+    const int M = ExpElementary<T, N>::M;
+    T a0 = a.x[0];
+
+    if (!(fabs(a0) < ldexp(T(1), ExpElementary<T, N>::B - std::numeric_limits<T>::digits))) {
+        s = c = Expansion<T, N>(std::numeric_limits<T>::quiet_NaN());
+        return;
+    }
+
+    // quadrant k and eighth j, |r - j pi/8| <= pi/16
+    T k = floor(a0 / e.pi_2.x[0] + T(0.5));
+    Expansion<T, M> r = a.template truncate<M>() - e.pi_2 * k;
+    T j = floor(r.x[0] / e.pi_8.x[0] + T(0.5));
+    r -= e.pi_8 * j;
+
+    Expansion<T, N> st, ct;
+    sincos_kernel(r.template truncate<N>(), st, ct);
+
+    int jj = (int)fabs(j);
+    Expansion<T, N> sj = j < 0 ? -e.sin_tab[jj] : e.sin_tab[jj], cj = e.cos_tab[jj];
+    Expansion<T, N> sr = sj * ct + cj * st, cr = cj * ct - sj * st;
+
+    switch ((int)(k - 4 * floor(k / 4))) {
+    case 0: s = sr;  c = cr;  break;
+    case 1: s = cr;  c = -sr; break;
+    case 2: s = -sr; c = -cr; break;
+    default: s = -cr; c = sr; break;
+    }
+}
+
+template <typename T, int N>
+inline Expansion<T, N> sin (const Expansion<T, N>& a) {
+    Expansion<T, N> s, c;
+    sincos(a, s, c);
+    return s;
+}
+
+template <typename T, int N>
+inline Expansion<T, N> cos (const Expansion<T, N>& a) {
+    Expansion<T, N> s, c;
+    sincos(a, s, c);
+    return c;
+}
+
+// ---- batched two-term path --------------------------------------------------
+//
+// exp_array, log_array, sin_array and cos_array of two-term arrays (double-
+// double, the case main and the benchmarks use) take EXP_ELEM_BLOCK elements
+// at a time through the steps of the functions above, each step one loop
+// over the block. The N = 2 operators of expansion.h have no branches; here
+// the reductions round with the 1.5 2^(p-1) trick instead of floor, scale by
+// powers of 2 built from the bits instead of ldexp, and pick table entries
+// and quadrants with selects, so every loop vectorizes across elements.
+// Zeros, infinities, NaNs and arguments out of the range of the block
+// reductions are flagged and redone one at a time by the functions above.
+
+// @brief the bit layout of T
+template <typename T> struct ExpBits;
+template <> struct ExpBits<double> { typedef uint64_t U; enum { mant = 52, bias = 1023 }; };
+template <> struct ExpBits<float>  { typedef uint32_t U; enum { mant = 23, bias = 127 }; };
+
+// @brief v rounded to an integer, ties to even; for |v| < 2^(p-2)
+template <typename T>
+inline T exp_round (T v) {
+    const T magic = T(3) * T(1ull << (std::numeric_limits<T>::digits - 2));
+    return (v + magic) - magic;
+}
+
+// @brief 2^k for an integer k in the normal exponent range of T
+template <typename T>
+inline T exp_pow2 (T k) {
+    typedef typename ExpBits<T>::U U;
+    T t = k + T(ExpBits<T>::bias + ((U)1 << ExpBits<T>::mant));
+    U u;
+    // the mantissa of t is k + bias, shifted into the exponent field
+    memcpy(&u, &t, sizeof(T));
+    u <<= ExpBits<T>::mant;
+    memcpy(&t, &u, sizeof(T));
+    return t;
+}
+
+// @brief the sign and exponent bits of v as a number: e + bias for a positive
+// normal v = m 2^e, m in [1, 2); 0 for zeros and subnormals, above 2 bias for
+// infinities, NaNs and negative v
+template <typename T>
+inline T exp_exponent_bits (T v) {
+    typedef typename ExpBits<T>::U U;
+    T two_mant = T((U)1 << ExpBits<T>::mant), t;
+    U u, b;
+    // the bits as the mantissa of 2^mant + them
+    memcpy(&u, &v, sizeof(T));
+    memcpy(&b, &two_mant, sizeof(T));
+    u = u >> ExpBits<T>::mant | b;
+    memcpy(&t, &u, sizeof(T));
+    return t - two_mant;
+}
+
+// @brief e 2^k for an integer k up to twice the exponent range of T, in two
+// factors, so that neither overflows or underflows on its own
+template <typename T>
+inline Expansion<T, 2> exp_scale (const Expansion<T, 2>& e, T k) {
+    T k1 = exp_round(k * T(0.5)), f1 = exp_pow2(k1), f2 = exp_pow2(k - k1);
+    Expansion<T, 2> r;
+    r.x[0] = e.x[0] * f1 * f2;
+    r.x[1] = e.x[1] * f1 * f2;
+    return r;
+}
+
+// @brief a - k c for an integer k and the M-term constant c: the products
+// k c_i are formed exactly and subtracted one at a time, the last rounded
+template <typename T, int M>
+inline Expansion<T, 2> exp_reduce (const Expansion<T, 2>& a, T k, const Expansion<T, M>& c) {
+    Expansion<T, 2> r = a, q;
+    EXP_UNROLL
+    for (int i = 0; i < M - 1; ++i) {
+        two_product(k, c.x[i], q.x[0], q.x[1]);
+        r -= q;
+    }
+    return r - k * c.x[M - 1];
+}
+
+// @brief c ? a : b term by term, which vectorizes where a select of the
+// whole expansion does not
+template <typename T>
+inline Expansion<T, 2> exp_select (bool c, const Expansion<T, 2>& a, Expansion<T, 2> b) {
+    b.x[0] = c ? a.x[0] : b.x[0];
+    b.x[1] = c ? a.x[1] : b.x[1];
+    return b;
+}
+
+// @brief a / b as operator/ for N = 2, without its branch for b == 0
+template <typename T>
+inline Expansion<T, 2> exp_div2 (const Expansion<T, 2>& a, const Expansion<T, 2>& b) {
+    Expansion<T, 2> y(T(1) / b.x[0]), q = a * y;
+    return q + y * (a - b * q);
+}
+
+// @brief r[i] = exp(a[i]) for i < n; flags the elements left to exp with
+// scalar[i] = 1 (a T, not a bool, so the loops store one width only). The
+// range checks are single comparisons, which GCC if-converts where it does
+// not a && of two.
+template <typename T>
+inline void exp_block (const Expansion<T, 2>* a, Expansion<T, 2>* r, T* scalar, int n) {
+    const ExpElementary<T, 2>& c = ExpElementary<T, 2>::get();
+    T hi = std::numeric_limits<T>::max_exponent * T(M_LN2);
+    T lo = (std::numeric_limits<T>::min_exponent - std::numeric_limits<T>::digits - 1) * T(M_LN2);
+    // a0 in [lo, hi], give or take a rounding; exp saturates either side
+    T mid = (hi + lo) * T(0.5), half = (hi - lo) * T(0.5);
+    T k[EXP_ELEM_BLOCK];
+    Expansion<T, 2> s[EXP_ELEM_BLOCK], p[EXP_ELEM_BLOCK];
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        bool out = !(fabs(a[i].x[0] - mid) <= half);
+        Expansion<T, 2> x = exp_select(out, Expansion<T, 2>(), a[i]);
+        scalar[i] = out ? T(1) : T(0);
+        k[i] = exp_round(x.x[0] / c.ln2.x[0]);
+        s[i] = exp_reduce(x, k[i], c.ln2) * T(1.0 / (1 << EXP_SQUARINGS));
+    }
+
+    c.exp_poly.eval(s, p, n);
+    for (i = 0; i < n; ++i)
+        p[i] = p[i] * s[i];
+    for (int j = 0; j < EXP_SQUARINGS; ++j)
+        for (i = 0; i < n; ++i)
+            p[i] = p[i] * (p[i] + T(2));
+    for (i = 0; i < n; ++i)
+        r[i] = exp_scale(p[i] + T(1), k[i]);
+}
+
+// @brief r[i] = log(a[i]) for i < n; flags the elements left to log
+template <typename T>
+inline void log_block (const Expansion<T, 2>* a, Expansion<T, 2>* r, T* scalar, int n) {
+    const ExpElementary<T, 2>& c = ExpElementary<T, 2>::get();
+    Expansion<T, 2> ln2 = c.ln2.template truncate<2>();
+    const T bias = ExpBits<T>::bias;
+    T e[EXP_ELEM_BLOCK];
+    Expansion<T, 2> z[EXP_ELEM_BLOCK], z2[EXP_ELEM_BLOCK], p[EXP_ELEM_BLOCK];
+    int i;
+
+    // m in [sqrt(1/2), sqrt(2)) as in log, e the exponent of a sqrt(2); the
+    // flagged elements go through with x = 0 and whatever e, and are dropped
+    for (i = 0; i < n; ++i) {
+        e[i] = exp_exponent_bits(a[i].x[0] * T(M_SQRT2)) - bias;
+        // a sqrt(2) positive and normal: e in [1 - bias, bias]
+        bool out = !(fabs(e[i] - T(0.5)) < bias);
+        Expansion<T, 2> x = exp_select(out, Expansion<T, 2>(), a[i]);
+        scalar[i] = out ? T(1) : T(0);
+        Expansion<T, 2> m = exp_scale(x, -e[i]);
+        z[i] = exp_div2(m - T(1), m + T(1));
+        z2[i] = z[i] * z[i];
+    }
+
+    c.log_poly.eval(z2, p, n);
+    for (i = 0; i < n; ++i)
+        r[i] = ln2 * e[i] + z[i] * p[i] * T(2);
+}
+
+// @brief s[i] = sin(a[i]) and c[i] = cos(a[i]) for i < n; flags the
+// elements left to sincos
+template <typename T>
+inline void sincos_block (const Expansion<T, 2>* a, Expansion<T, 2>* s, Expansion<T, 2>* c, T* scalar, int n) {
+    const ExpElementary<T, 2>& e = ExpElementary<T, 2>::get();
+    // k below stays in the range of exp_round
+    const T limit = T(1ull << (std::numeric_limits<T>::digits - 2));
+    T k[EXP_ELEM_BLOCK], j[EXP_ELEM_BLOCK];
+    Expansion<T, 2> t[EXP_ELEM_BLOCK], t2[EXP_ELEM_BLOCK], st[EXP_ELEM_BLOCK], ct[EXP_ELEM_BLOCK];
+    int i;
+
+    // quadrant k and eighth j, |t| <= pi/16
+    for (i = 0; i < n; ++i) {
+        bool out = !(fabs(a[i].x[0]) < limit);
+        Expansion<T, 2> x = exp_select(out, Expansion<T, 2>(), a[i]);
+        scalar[i] = out ? T(1) : T(0);
+        k[i] = exp_round(x.x[0] / e.pi_2.x[0]);
+        Expansion<T, 2> r = exp_reduce(x, k[i], e.pi_2);
+        j[i] = exp_round(r.x[0] / e.pi_8.x[0]);
+        t[i] = exp_reduce(r, j[i], e.pi_8);
+        t2[i] = t[i] * t[i];
+    }
+
+    e.sin_poly.eval(t2, st, n);
+    e.cos_poly.eval(t2, ct, n);
+    for (i = 0; i < n; ++i) {
+        T aj = fabs(j[i]), q = k[i] - 4 * exp_round((k[i] - T(1.5)) * T(0.25));
+        Expansion<T, 2> sj = exp_select(aj == 1, e.sin_tab[1], exp_select(aj == 2, e.sin_tab[2], e.sin_tab[0]));
+        Expansion<T, 2> cj = exp_select(aj == 1, e.cos_tab[1], exp_select(aj == 2, e.cos_tab[2], e.cos_tab[0]));
+        sj = sj * (j[i] < 0 ? T(-1) : T(1));
+        st[i] = st[i] * t[i];
+
+        // the quadrants as in sincos, with signs as factors of 1 and -1
+        Expansion<T, 2> sr = sj * ct[i] + cj * st[i], cr = cj * ct[i] - sj * st[i];
+        bool odd = q == 1 || q == 3;
+        s[i] = exp_select(odd, cr, sr) * (q >= 2 ? T(-1) : T(1));
+        c[i] = exp_select(odd, sr, cr) * (q == 1 || q == 2 ? T(-1) : T(1));
+    }
+}
+
+// the block kernels as function objects, for exp_map_array below
+
+struct ExpBlockExp {
+    template <typename T>
+    void operator() (const Expansion<T, 2>* x, Expansion<T, 2>* y, T* scalar, int n) const {
+        exp_block(x, y, scalar, n);
+    }
+};
+
+struct ExpBlockLog {
+    template <typename T>
+    void operator() (const Expansion<T, 2>* x, Expansion<T, 2>* y, T* scalar, int n) const {
+        log_block(x, y, scalar, n);
+    }
+};
+
+struct ExpBlockSin {
+    template <typename T>
+    void operator() (const Expansion<T, 2>* x, Expansion<T, 2>* y, T* scalar, int n) const {
+        Expansion<T, 2> c[EXP_ELEM_BLOCK];
+        sincos_block(x, y, c, scalar, n);
+    }
+};
+
+struct ExpBlockCos {
+    template <typename T>
+    void operator() (const Expansion<T, 2>* x, Expansion<T, 2>* y, T* scalar, int n) const {
+        Expansion<T, 2> s[EXP_ELEM_BLOCK];
+        sincos_block(x, s, y, scalar, n);
+    }
+};
+
+// batched over arrays: r[i] = f(a[i]), split over threads; the elements are
+// independent and every one takes the same steps, so the load is even and
+// the results do not depend on the number of threads. Two-term arrays go a
+// block at a time through kernel(x, y, scalar, n), with f for the flagged
+// elements; other lengths one element at a time through f.
+
+template <typename T, int N, typename K, typename F>
+inline void exp_map_array (const ExpansionArray<T, N>& a, ExpansionArray<T, N>& r, K, F f) {
+    // allocated up front, so that set() does not allocate inside the loop
+    for (int k = 0; k < N; ++k)
+        r.term(k);
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long)a.size(); ++i)
+        r.set(i, f(a.get(i)));
+}
+
+template <typename T, typename K, typename F>
+inline void exp_map_array (const ExpansionArray<T, 2>& a, ExpansionArray<T, 2>& r, K kernel, F f) {
+    const T *a1 = a.term(0), *a2 = a.term(1);
+    T *r1 = r.term(0), *r2 = r.term(1);
+    long nb = (a.size() + EXP_ELEM_BLOCK - 1) / EXP_ELEM_BLOCK;
+
+    #pragma omp parallel for schedule(static)
+    for (long b = 0; b < nb; ++b) {
+        unsigned long i0 = b * (unsigned long)EXP_ELEM_BLOCK;
+        int n = (int)std::min((unsigned long)EXP_ELEM_BLOCK, a.size() - i0), i;
+        Expansion<T, 2> x[EXP_ELEM_BLOCK], y[EXP_ELEM_BLOCK];
+        T scalar[EXP_ELEM_BLOCK];
+
+        for (i = 0; i < n; ++i) {
+            x[i].x[0] = a1[i0 + i];
+            x[i].x[1] = a2 ? a2[i0 + i] : T(0);
+        }
+        kernel(x, y, scalar, n);
+        for (i = 0; i < n; ++i)
+            if (scalar[i])
+                y[i] = f(x[i]);
+        for (i = 0; i < n; ++i) {
+            r1[i0 + i] = y[i].x[0];
+            r2[i0 + i] = y[i].x[1];
+        }
+    }
+}
+
+template <typename T, int N>
+inline void exp_array (const ExpansionArray<T, N>& a, ExpansionArray<T, N>& r) {
+    exp_map_array(a, r, ExpBlockExp(), [](const Expansion<T, N>& x) { return exp(x); });
+}
+
+template <typename T, int N>
+inline void log_array (const ExpansionArray<T, N>& a, ExpansionArray<T, N>& r) {
+    exp_map_array(a, r, ExpBlockLog(), [](const Expansion<T, N>& x) { return log(x); });
+}
+
+template <typename T, int N>
+inline void sin_array (const ExpansionArray<T, N>& a, ExpansionArray<T, N>& r) {
+    exp_map_array(a, r, ExpBlockSin(), [](const Expansion<T, N>& x) { return sin(x); });
+}
+
+template <typename T, int N>
+inline void cos_array (const ExpansionArray<T, N>& a, ExpansionArray<T, N>& r) {
+    exp_map_array(a, r, ExpBlockCos(), [](const Expansion<T, N>& x) { return cos(x); });
+}
+
+#endif //EXPFLOAT_EXPANSION_ELEMENTARY_H
@@ -0,0 +1,217 @@
+//
+// On-disk format for ExpansionArray<T, N>, read back through mmap.
+//
+// The file is a one-page header followed by one section per term level, each
+// the contiguous term(k) stream of the array, starting on a page boundary:
+//
+//     [ ExpFileHeader | pad ][ term 0 | pad ][ term 1 | pad ] ...
+//
+// Term levels the array never wrote are not stored (offset 0) and read as
+// zero, as in ExpansionArray. MappedExpansionArray maps every section on its
+// own and only when it is first asked for, so a reader that wants float
+// precision out of a float-float file maps and touches only the pages of the
+// leading terms; the lower ones are not read from disk at all, which is
+// truncation to the needed precision at I/O time.
+//
+
+#ifndef EXPFLOAT_EXPANSION_FILE_H
+#define EXPFLOAT_EXPANSION_FILE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <expansion.h>
+#include <expansion_array.h>
+
+#define EXP_FILE_MAX_TERMS 8
+
+struct ExpFileHeader {
+    char magic[8];                          // "EXPARRAY"
+    uint32_t value_size;                    // sizeof(T)
+    uint32_t terms;                         // N
+    uint64_t n;                             // elements
+    uint64_t align;                         // page size of the writer
+    uint64_t offset[EXP_FILE_MAX_TERMS];    // of every term section, 0 if not stored
+};
+
+// @brief x rounded up to a multiple of align
+inline uint64_t exp_file_round (uint64_t x, uint64_t align) {
+    return (x + align - 1) / align * align;
+}
+
+// @brief write a to path; returns false with errno set on failure
+template <typename T, int N>
+bool exp_file_write(const char* path, const ExpansionArray<T, N>& a) {
+    static_assert(N <= EXP_FILE_MAX_TERMS, "too many terms for the file header");
+    ExpFileHeader hdr;
+    uint64_t align = sysconf(_SC_PAGESIZE), bytes = a.size() * sizeof(T), at;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "EXPARRAY", 8);
+    hdr.value_size = sizeof(T);
+    hdr.terms = N;
+    hdr.n = a.size();
+    hdr.align = align;
+    at = exp_file_round(sizeof(hdr), align);
+    for (int k = 0; k < N; ++k) {
+        if (!a.has_term(k))
+            continue;
+        hdr.offset[k] = at;
+        at += exp_file_round(bytes, align);
+    }
+
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    // the size first, so that the padding is a hole rather than written zeros
+    bool ok = ftruncate(fd, at) == 0 && pwrite(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr);
+    for (int k = 0; k < N && ok; ++k) {
+        if (!hdr.offset[k])
+            continue;
+        const char* p = reinterpret_cast<const char*>(a.term(k));
+        for (uint64_t done = 0; ok && done < bytes; ) {
+            ssize_t w = pwrite(fd, p + done, bytes - done, hdr.offset[k] + done);
+            if (w < 0 && errno == EINTR)
+                continue;
+            // no progress without an error: report it as one
+            if (w == 0)
+                errno = EIO;
+            ok = w > 0;
+            done += ok ? w : 0;
+        }
+    }
+    // on disk before returning, so the pages are clean and can be dropped
+    ok = ok && fdatasync(fd) == 0;
+    int saved = errno;
+    ok = (close(fd) == 0) && ok;
+    if (!ok && saved)
+        errno = saved;
+    return ok;
+}
+
+template <typename T, int N>
+class MappedExpansionArray {
+public:
+    MappedExpansionArray() : m_fd(-1) {
+        memset(&m_hdr, 0, sizeof(m_hdr));
+        for (int k = 0; k < N; ++k) {
+            m_map[k] = NULL;
+            m_len[k] = 0;
+        }
+    }
+
+    ~MappedExpansionArray() { close(); }
+
+    MappedExpansionArray(const MappedExpansionArray&) = delete;
+    MappedExpansionArray& operator= (const MappedExpansionArray&) = delete;
+
+    // @brief open a file written by exp_file_write for the same T and N; no
+    // term is mapped yet. Returns false with errno set (EINVAL if the file is
+    // not such an array).
+    bool open(const char* path) {
+        struct stat st;
+
+        close();
+        m_fd = ::open(path, O_RDONLY);
+        if (m_fd < 0)
+            return false;
+        if (pread(m_fd, &m_hdr, sizeof(m_hdr), 0) != (ssize_t)sizeof(m_hdr) || fstat(m_fd, &st) != 0
+            || memcmp(m_hdr.magic, "EXPARRAY", 8) != 0 || m_hdr.value_size != sizeof(T) || m_hdr.terms != N) {
+            close();
+            errno = EINVAL;
+            return false;
+        }
+        for (int k = 0; k < N; ++k) {
+            // divided rather than multiplied, so a corrupt n cannot wrap around
+            if (m_hdr.offset[k] && (m_hdr.offset[k] > (uint64_t)st.st_size
+                                    || m_hdr.n > ((uint64_t)st.st_size - m_hdr.offset[k]) / sizeof(T))) {
+                close();
+                errno = EINVAL;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        for (int k = 0; k < N; ++k) {
+            if (m_map[k])
+                munmap(m_map[k], m_len[k]);
+            m_map[k] = NULL;
+            m_len[k] = 0;
+        }
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+    }
+
+    unsigned long size() const { return m_hdr.n; }
+
+    bool has_term(int k) const { return m_hdr.offset[k] != 0; }
+
+    // @brief the k-th term stream, mapped on first use; NULL if the term is not
+    // stored or cannot be mapped
+    const T* term(int k) const {
+        if (!m_map[k] && has_term(k) && m_hdr.n) {
+            uint64_t page = sysconf(_SC_PAGESIZE);
+            uint64_t start = m_hdr.offset[k] / page * page, skip = m_hdr.offset[k] - start;
+            size_t len = skip + m_hdr.n * sizeof(T);
+            void* p = mmap(NULL, len, PROT_READ, MAP_SHARED, m_fd, start);
+            if (p == MAP_FAILED)
+                return NULL;
+            m_map[k] = p;
+            m_len[k] = len;
+        }
+        return m_map[k] ? reinterpret_cast<const T*>(static_cast<char*>(m_map[k]) + (m_len[k] - m_hdr.n * sizeof(T)))
+                        : NULL;
+    }
+
+    // @brief zero-copy view of the leading terms
+    const T* top() const { return term(0); }
+
+    // @brief element i truncated to its first `terms` terms; only those are mapped
+    Expansion<T, N> get(unsigned long i, int terms = N) const {
+        Expansion<T, N> e;
+        for (int k = 0; k < N; ++k) {
+            const T* t = k < terms ? term(k) : NULL;
+            e.x[k] = t ? t[i] : T(0);
+        }
+        return e;
+    }
+
+    // @brief bytes of term k that are in memory (page cache), from mincore;
+    // 0 if the term is not mapped
+    unsigned long resident(int k) const {
+        if (!m_map[k])
+            return 0;
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        std::vector<unsigned char> vec((m_len[k] + page - 1) / page);
+        if (mincore(m_map[k], m_len[k], &vec[0]) != 0)
+            return 0;
+        unsigned long cnt = 0;
+        for (size_t j = 0; j < vec.size(); ++j)
+            cnt += vec[j] & 1;
+        return cnt * page;
+    }
+
+    // @brief ask the kernel to drop the cached pages of the whole file, e.g.
+    // to measure cold reads; dirty pages of the writer need an fsync first
+    void drop_cache() const {
+        if (m_fd >= 0)
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+
+private:
+    int m_fd;
+    ExpFileHeader m_hdr;
+    mutable void* m_map[N];
+    mutable size_t m_len[N];
+};
+
+#endif //EXPFLOAT_EXPANSION_FILE_H
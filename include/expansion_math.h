@@ -5,8 +5,24 @@
 #ifndef EXPFLOAT_EXPANSION_MATH_H
 #define EXPFLOAT_EXPANSION_MATH_H
 
+#include <math.h>
+
 #define S 16
 
+// Dekker's splitter for a 24-bit significand, 2^12 + 1: a_hi and a_lo have
+// 12 bits each, so the partial products in two_product are exact
+#define SPLIT_FLOAT ((1 << 12) + 1)
+
+// fully unroll loops with a compile-time trip count (the expansion terms, the
+// coefficients of a fixed-degree polynomial)
+#if defined(__GNUC__) && !defined(__clang__)
+#define EXP_UNROLL _Pragma("GCC unroll 16")
+#elif defined(__clang__)
+#define EXP_UNROLL _Pragma("unroll")
+#else
+#define EXP_UNROLL
+#endif
+
 // @brief computes the sum of two single precision floating point values and computes
 // their double precision sum in the expansion form
 
@@ -50,32 +66,97 @@ grow_expansion (float& e1, float& e2, float b) {
 
 inline void
 fast_expansion_sum (float& e1, float& e2, float f1, float f2) {
-    float q,h;
+    float q,h,g,x,y;
 
     two_sum(f2, e2, q, h);
     if (e1 < f1) { // want branch to fail
-        two_sum(q,e1,q,h);
-        two_sum(q,f1,e1,e2);
+        two_sum(q,e1,q,g);
+        two_sum(q,f1,x,y);
     } else {
-        two_sum(q,f1,q,h);
-        two_sum(q,e1,e1,e2);
+        two_sum(q,f1,q,g);
+        two_sum(q,e1,x,y);
 
     }
 
+    // fold the errors of the partial sums back in, dropping them loses
+    // everything below the leading term when merging large expansions
+    fast_two_sum(x, y + (g + h), e1, e2);
+}
+
+// Branch-free variants. The comparisons above depend on the data, so on
+// unordered input they mispredict about half of the time and keep the loops
+// around them from vectorizing. Here the operands are ordered with selects
+// (compiled to blends or minss/maxss) instead; the operations and results are
+// the same.
+
+// @brief fast_two_sum, ordering a and b by magnitude without a branch
+inline void
+fast_two_sum_select(float a, float b, float& x, float& y) {
+    bool ge = fabsf(a) >= fabsf(b);
+    float hi = ge ? a : b;
+    float lo = ge ? b : a;
+
+    x = hi + lo;
+    y = lo - (x - hi);
+}
+
+// @brief fast_expansion_sum, with min/max in place of the e1 < f1 branch
+inline void
+fast_expansion_sum_select (float& e1, float& e2, float f1, float f2) {
+    float q,h,g,x,y;
+    bool lt = e1 < f1;
+    float lo = lt ? e1 : f1, hi = lt ? f1 : e1;
+
+    two_sum(f2, e2, q, h);
+    two_sum(q,lo,q,g);
+    two_sum(q,hi,x,y);
+
+    fast_two_sum_select(x, y + (g + h), e1, e2);
+}
+
+// @brief (e1, e2) += (f1, f2) with two_sum throughout: no ordering at all,
+// at 3 more flops per step
+inline void
+expansion_sum (float& e1, float& e2, float f1, float f2) {
+    float q,h,g,x,y;
+
+    two_sum(f2, e2, q, h);
+    two_sum(q,e1,q,g);
+    two_sum(q,f1,x,y);
+
+    two_sum(x, y + (g + h), e1, e2);
+}
+
+// @brief (e1, e2) += (f1, f2): two_sum of the leading terms, the low terms
+// combined in one rounding and folded back with Dekker's step; the scalar
+// form of v_expansion_sum
+inline void
+quick_expansion_sum (float& e1, float& e2, float f1, float f2) {
+    float s, e;
+
+    two_sum(e1, f1, s, e);
+    e = e + (e2 + f2);
+    e1 = s + e;
+    e2 = e - (e1 - s);
 }
 
 inline void
 split (float a, float& a_hi, float& a_lo) {
     float c, ab;
 
-    c = ((1 << S) + 1) * a;
+    c = SPLIT_FLOAT * a;
     ab = c - a;
     a_hi = c - ab;
     a_lo = a - a_hi;
 }
 
+// as the double two_product below, a fused multiply-subtract where there is one
 inline void
 two_product (float a, float b, float&x, float& y) {
+#if defined(__FMA__) || defined(FP_FAST_FMAF)
+    x = a*b;
+    y = fmaf(a, b, -x);
+#else
     float a_hi, a_lo, b_hi, b_lo, err1, err2;
 
     x = a*b;
@@ -88,6 +169,83 @@ two_product (float a, float b, float&x, float& y) {
     err1 = err2 - (a_hi * b_lo);
 
     y = (a_lo * b_lo) - err1;
+#endif
+}
+
+// double precision versions of the error-free transformations, used by the
+// double based expansions in expansion.h
+
+inline void
+fast_two_sum(double a, double b, double& x, double& y) {
+    double v;
+
+    x = a+b;
+    if ((a>b) == (a>-b)) {
+        v  = x - a;
+        y = b - v;
+    } else {
+        v  = x - b;
+        y = a - v;
+    }
+}
+
+inline void
+fast_two_sum_select(double a, double b, double& x, double& y) {
+    bool ge = fabs(a) >= fabs(b);
+    double hi = ge ? a : b;
+    double lo = ge ? b : a;
+
+    x = hi + lo;
+    y = lo - (x - hi);
+}
+
+inline void
+two_sum(double a, double b, double& x, double& y) {
+    double av, bv, ar, br;
+
+    x = a+b;
+
+    bv = x - a;
+    av = x - bv;
+
+    br = b - bv;
+    ar = a - av;
+
+    y = ar+ br;
+}
+
+inline void
+split (double a, double& a_hi, double& a_lo) {
+    double c, ab;
+
+    c = ((1 << 27) + 1) * a;
+    ab = c - a;
+    a_hi = c - ab;
+    a_lo = a - a_hi;
+}
+
+// with a hardware FMA the rounding error of a*b is a single fused
+// multiply-subtract; fma() in software is slower than the split, so it is only
+// used where it is an instruction
+inline void
+two_product (double a, double b, double&x, double& y) {
+#if defined(__FMA__) || defined(FP_FAST_FMA)
+    x = a*b;
+    y = fma(a, b, -x);
+#else
+    double a_hi, a_lo, b_hi, b_lo, err1, err2;
+
+    x = a*b;
+
+    split (a, a_hi, a_lo);
+    split (b, b_hi, b_lo);
+
+    err1 = x - (a_hi * b_hi);
+    err2 = err1 - (a_lo * b_hi);
+    err1 = err2 - (a_hi * b_lo);
+
+    y = (a_lo * b_lo) - err1;
+#endif
 }
 
 // scale (e1,e2) by a
@@ -108,7 +266,7 @@ daxpy (float *x1, float *x2, float a, float b) {
   grow_expansion(*x1, *x2, b);
 }
 
-// todo Add code for dot product, matvec, dgemm, rk4
+// todo Add code for rk4 (matvec and dgemm are in expansion_blas.h)
 
 inline void exp_dot (float* a, float* b, unsigned int n, float& r1, float& r2) {
     float x=0.0, y=0.0;
@@ -120,6 +278,45 @@ inline void exp_dot (float* a, float* b, unsigned int n, float& r1, float& r2) {
     }
 }
 
+// @brief reduce K interleaved expansions into (r1, r2), always in lane order
+template <int K>
+inline void merge_lanes (const float* l1, const float* l2, float& r1, float& r2) {
+    r1 = l1[0]; r2 = l2[0];
+    for (int k = 1; k < K; ++k)
+        fast_expansion_sum(r1, r2, l1[k], l2[k]);
+}
+
+// @brief same as the grow_expansion loop over a, but with K independent
+// accumulators so consecutive two_sums do not wait on each other.
+template <int K>
+inline void exp_sum_lanes (const float* a, unsigned int n, float& r1, float& r2) {
+    float l1[K] = {0}, l2[K] = {0};
+    unsigned int i = 0;
+
+    for (; i + K <= n; i += K)
+        for (int k = 0; k < K; ++k)
+            grow_expansion(l1[k], l2[k], a[i+k]);
+    for (int k = 0; i < n; ++i, ++k)
+        grow_expansion(l1[k], l2[k], a[i]);
+
+    merge_lanes<K>(l1, l2, r1, r2);
+}
+
+// @brief exp_dot with K independent accumulators
+template <int K>
+inline void exp_dot_lanes (const float* a, const float* b, unsigned int n, float& r1, float& r2) {
+    float l1[K] = {0}, l2[K] = {0};
+    unsigned int i = 0;
+
+    for (; i + K <= n; i += K)
+        for (int k = 0; k < K; ++k)
+            grow_expansion(l1[k], l2[k], a[i+k]*b[i+k]);
+    for (int k = 0; i < n; ++i, ++k)
+        grow_expansion(l1[k], l2[k], a[i]*b[i]);
+
+    merge_lanes<K>(l1, l2, r1, r2);
+}
+
 template <typename T>
 inline T dot (T* a, T* b, int n) {
     T res = 0.0;
@@ -129,6 +326,34 @@ inline T dot (T* a, T* b, int n) {
     return res;
 }
 
+// @brief p(x) = a[0] + a[1] x + ... + a[degree] x^degree by Horner's rule
+template <typename T>
+inline T horner (const T* a, int degree, T x) {
+    T s = a[degree];
+    for (int i = degree - 1; i >= 0; --i)
+        s = s * x + a[i];
+    return s;
+}
+
+// @brief compensated Horner (Graillat, Langlois & Louvet): Horner's rule with
+// the rounding errors of each step recovered by two_product and two_sum and
+// evaluated by a second Horner recurrence, returned as the expansion (r1, r2).
+// As accurate as Horner's rule in twice the working precision:
+// |r1 + r2 - p(x)| <= u |p(x)| + (2 degree u)^2 sum |a_i x^i|, with u = 2^-24.
+// The bound needs the exact two_product above; with u^2 = 2^-48 it is within
+// a few bits of Horner in double, so near ill-conditioned roots the two are
+// about as inaccurate.
+inline void
+comp_horner (const float* a, int degree, float x, float& r1, float& r2) {
+    float s = a[degree], c = 0.0f, p, pi, sigma;
+    for (int i = degree - 1; i >= 0; --i) {
+        two_product(s, x, p, pi);
+        two_sum(p, a[i], s, sigma);
+        c = c * x + (pi + sigma);
+    }
+    fast_two_sum_select(s, c, r1, r2);
+}
+
 
 
 #endif //EXPFLOAT_EXPANSION_MATH_H
@@ -0,0 +1,69 @@
+//
+// Multithreaded expansion reductions.
+//
+// The input is cut into blocks of a fixed size that does not depend on the
+// number of threads; every block reduces into its own expansion and the block
+// results are merged in block order with fast_expansion_sum. The threads only
+// decide who computes which block, so the answer is bitwise identical for any
+// thread count (and without OpenMP).
+//
+
+#ifndef EXPFLOAT_EXPANSION_PARALLEL_H
+#define EXPFLOAT_EXPANSION_PARALLEL_H
+
+#include <algorithm>
+#include <vector>
+
+#include <expansion_math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define EXP_BLOCK 16384
+
+inline int exp_num_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// @brief sum of a[0..n) in expansion form, in parallel over blocks
+inline void
+exp_sum_parallel (const float* a, unsigned long n, float& r1, float& r2,
+                  unsigned long block = EXP_BLOCK) {
+    long nb = (n + block - 1) / block;
+    std::vector<float> b1(nb), b2(nb);
+
+    #pragma omp parallel for schedule(static)
+    for (long k = 0; k < nb; ++k) {
+        unsigned long lo = k * block, hi = std::min(n, lo + block);
+        exp_sum_lanes<8>(a + lo, hi - lo, b1[k], b2[k]);
+    }
+
+    r1 = 0.0; r2 = 0.0;
+    for (long k = 0; k < nb; ++k)
+        fast_expansion_sum(r1, r2, b1[k], b2[k]);
+}
+
+// @brief exp_dot in parallel over blocks
+inline void
+exp_dot_parallel (const float* a, const float* b, unsigned long n, float& r1, float& r2,
+                  unsigned long block = EXP_BLOCK) {
+    long nb = (n + block - 1) / block;
+    std::vector<float> b1(nb), b2(nb);
+
+    #pragma omp parallel for schedule(static)
+    for (long k = 0; k < nb; ++k) {
+        unsigned long lo = k * block, hi = std::min(n, lo + block);
+        exp_dot_lanes<8>(a + lo, b + lo, hi - lo, b1[k], b2[k]);
+    }
+
+    r1 = 0.0; r2 = 0.0;
+    for (long k = 0; k < nb; ++k)
+        fast_expansion_sum(r1, r2, b1[k], b2[k]);
+}
+
+#endif //EXPFLOAT_EXPANSION_PARALLEL_H
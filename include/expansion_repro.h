@@ -0,0 +1,167 @@
+//
+// Reproducible expansion summation.
+//
+// Pre-rounding in the style of Demmel & Nguyen (ReproBLAS): with t chosen so
+// that every |a_i| < 2^(t-1), adding and subtracting E = 1.5*2^t rounds a_i
+// to a multiple of ulp(E) = 2^(t-23) -- the first half of fast_two_sum, and
+// exact. That part is an integer of at most 22 bits in units of ulp(E) and is
+// accumulated in a 64-bit integer bin, the exact remainder goes on to the next
+// bin 23 bits further down. Integer addition is associative, so the bins, and
+// the expansion built from them, are bitwise identical for any summation
+// order, chunking or thread count. REPRO_FOLD bins keep 69 bits below the
+// largest |a_i|.
+//
+
+#ifndef EXPFLOAT_EXPANSION_REPRO_H
+#define EXPFLOAT_EXPANSION_REPRO_H
+
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+
+#include <expansion_math.h>
+#include <expansion.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define REPRO_FOLD 3
+
+// largest bin exponent: E = 1.5*2^t is still finite for t = 127
+#define REPRO_TMAX 127
+
+// @brief the bin exponent t for a[0..n): every |a_i| < 2^(t-1). Inf and NaN
+// are left out of the maximum and summed into special instead, which stays 0
+// only if all a_i are finite.
+inline int
+repro_exponent (const float* a, unsigned long n, float& special) {
+    float m = 0.0f;
+    int e;
+
+    special = 0.0f;
+    for (unsigned long i = 0; i < n; ++i) {
+        if (!std::isfinite(a[i]))
+            special += a[i];
+        else
+            m = std::max(m, std::fabs(a[i]));
+    }
+
+    frexpf(m, &e);
+    return e + 1;
+}
+
+// @brief add the pre-rounded parts of a[0..n) to the bins I. For t above
+// REPRO_TMAX (max |a_i| >= 2^126) E would overflow, so a_i is scaled by the
+// exact power of two 2^(REPRO_TMAX - t) first, which can only lose bits
+// far below the last bin; the bins stay in units of 2^(t - 23(k+1)) either way.
+inline void
+repro_accumulate (const float* a, unsigned long n, int t, long long* I) {
+    float  E[REPRO_FOLD];
+    double s[REPRO_FOLD];
+    long long I0 = 0, I1 = 0, I2 = 0;
+    int d = std::max(0, t - REPRO_TMAX);
+    float scale = ldexpf(1.0f, -d);
+
+    t -= d;
+    for (int k = 0; k < REPRO_FOLD; ++k) {
+        E[k] = ldexpf(1.5f, t - 23*k);
+        s[k] = ldexp(1.0, 23*(k+1) - t);
+    }
+
+    for (unsigned long i = 0; i < n; ++i) {
+        float x = a[i] * scale, q;
+
+        q = (x + E[0]) - E[0];
+        I0 += (long long)(q * s[0]);
+        x -= q;
+
+        q = (x + E[1]) - E[1];
+        I1 += (long long)(q * s[1]);
+        x -= q;
+
+        q = (x + E[2]) - E[2];
+        I2 += (long long)(q * s[2]);
+    }
+
+    I[0] += I0; I[1] += I1; I[2] += I2;
+}
+
+// @brief turn the bins into the expansion (r1, r2); fixed order, so the result
+// only depends on the bins.
+inline void
+repro_finalize (int t, const long long* I, float& r1, float& r2) {
+    float terms[3*REPRO_FOLD], e[2];
+    int m = 0;
+
+    for (int k = 0; k < REPRO_FOLD; ++k) {
+        long long v = I[k];
+        // an int64 needs up to three floats to be represented exactly
+        for (int j = 0; j < 3; ++j) {
+            float h = (float) v;
+            v -= (long long) h;
+            terms[m++] = ldexpf(h, t - 23*(k+1));
+        }
+    }
+
+    renormalize<float, 3*REPRO_FOLD, 2>(terms, e);
+    r1 = e[0]; r2 = e[1];
+}
+
+// @brief reproducible sum of a[0..n) in expansion form; with any Inf or NaN
+// in a the result is their sum (Inf or NaN) and r2 = 0
+inline void
+exp_sum_repro (const float* a, unsigned long n, float& r1, float& r2) {
+    long long I[REPRO_FOLD] = {0};
+    float special;
+    int t = repro_exponent(a, n, special);
+
+    if (special != 0.0f) {
+        r1 = special; r2 = 0.0f;
+        return;
+    }
+    repro_accumulate(a, n, t, I);
+    repro_finalize(t, I, r1, r2);
+}
+
+// @brief exp_sum_repro split across threads; bitwise identical to the serial
+// version whatever the thread count
+inline void
+exp_sum_repro_parallel (const float* a, unsigned long n, float& r1, float& r2) {
+    long long I0 = 0, I1 = 0, I2 = 0;
+    float m = 0.0f, special = 0.0f;
+    int t;
+
+    // the sum of the non-finite values is Inf, -Inf or NaN in any order
+    #pragma omp parallel for reduction(max:m) reduction(+:special)
+    for (long i = 0; i < (long) n; ++i) {
+        if (!std::isfinite(a[i]))
+            special += a[i];
+        else
+            m = std::max(m, std::fabs(a[i]));
+    }
+    if (special != 0.0f) {
+        r1 = special; r2 = 0.0f;
+        return;
+    }
+    frexpf(m, &t);
+    t += 1;
+
+    #pragma omp parallel reduction(+:I0,I1,I2)
+    {
+        long long I[REPRO_FOLD] = {0};
+        unsigned long lo = 0, hi = n;
+#ifdef _OPENMP
+        unsigned long nt = omp_get_num_threads(), id = omp_get_thread_num();
+        lo = n * id / nt;
+        hi = n * (id + 1) / nt;
+#endif
+        repro_accumulate(a + lo, hi - lo, t, I);
+        I0 += I[0]; I1 += I[1]; I2 += I[2];
+    }
+
+    long long I[REPRO_FOLD] = {I0, I1, I2};
+    repro_finalize(t, I, r1, r2);
+}
+
+#endif //EXPFLOAT_EXPANSION_REPRO_H
@@ -0,0 +1,568 @@
+//
+// Batched expansion kernels over arrays.
+//
+// The scalar kernels in expansion_math.h work on one float at a time; the
+// versions here process EXP_SIMD_WIDTH lanes per step (16 with AVX-512, 8 with
+// AVX2, 4 with SSE4.1) and fall back to the scalar kernels for the tail or when the compiler
+// was not told about either ISA.
+//
+
+#ifndef EXPFLOAT_EXPANSION_SIMD_H
+#define EXPFLOAT_EXPANSION_SIMD_H
+
+#include <math.h>
+
+#include <expansion_math.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+
+#define EXP_SIMD_WIDTH 16
+
+typedef __m512 vfloat;
+
+inline vfloat v_load(const float* p)          { return _mm512_loadu_ps(p); }
+inline void   v_store(float* p, vfloat a)     { _mm512_storeu_ps(p, a); }
+inline vfloat v_set1(float a)                 { return _mm512_set1_ps(a); }
+inline vfloat v_add(vfloat a, vfloat b)       { return _mm512_add_ps(a, b); }
+inline vfloat v_sub(vfloat a, vfloat b)       { return _mm512_sub_ps(a, b); }
+inline vfloat v_mul(vfloat a, vfloat b)       { return _mm512_mul_ps(a, b); }
+inline vfloat v_fmsub(vfloat a, vfloat b, vfloat c) { return _mm512_fmsub_ps(a, b, c); }
+inline vfloat v_min(vfloat a, vfloat b)       { return _mm512_min_ps(a, b); }
+inline vfloat v_max(vfloat a, vfloat b)       { return _mm512_max_ps(a, b); }
+
+// @brief hi, lo = a, b ordered by magnitude, with a masked blend
+inline void v_order_abs(vfloat a, vfloat b, vfloat& hi, vfloat& lo) {
+    __mmask16 ge = _mm512_cmp_ps_mask(_mm512_abs_ps(a), _mm512_abs_ps(b), _CMP_GE_OQ);
+    hi = _mm512_mask_blend_ps(ge, b, a);
+    lo = _mm512_mask_blend_ps(ge, a, b);
+}
+
+#elif defined(__AVX2__)
+
+#define EXP_SIMD_WIDTH 8
+
+typedef __m256 vfloat;
+
+inline vfloat v_load(const float* p)          { return _mm256_loadu_ps(p); }
+inline void   v_store(float* p, vfloat a)     { _mm256_storeu_ps(p, a); }
+inline vfloat v_set1(float a)                 { return _mm256_set1_ps(a); }
+inline vfloat v_add(vfloat a, vfloat b)       { return _mm256_add_ps(a, b); }
+inline vfloat v_sub(vfloat a, vfloat b)       { return _mm256_sub_ps(a, b); }
+inline vfloat v_mul(vfloat a, vfloat b)       { return _mm256_mul_ps(a, b); }
+#ifdef __FMA__
+inline vfloat v_fmsub(vfloat a, vfloat b, vfloat c) { return _mm256_fmsub_ps(a, b, c); }
+#endif
+inline vfloat v_min(vfloat a, vfloat b)       { return _mm256_min_ps(a, b); }
+inline vfloat v_max(vfloat a, vfloat b)       { return _mm256_max_ps(a, b); }
+
+// @brief hi, lo = a, b ordered by magnitude, with blendv
+inline void v_order_abs(vfloat a, vfloat b, vfloat& hi, vfloat& lo) {
+    vfloat sign = _mm256_set1_ps(-0.0f);
+    vfloat ge = _mm256_cmp_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, b), _CMP_GE_OQ);
+    hi = _mm256_blendv_ps(b, a, ge);
+    lo = _mm256_blendv_ps(a, b, ge);
+}
+
+#elif defined(__SSE4_1__)
+
+#define EXP_SIMD_WIDTH 4
+
+typedef __m128 vfloat;
+
+inline vfloat v_load(const float* p)          { return _mm_loadu_ps(p); }
+inline void   v_store(float* p, vfloat a)     { _mm_storeu_ps(p, a); }
+inline vfloat v_set1(float a)                 { return _mm_set1_ps(a); }
+inline vfloat v_add(vfloat a, vfloat b)       { return _mm_add_ps(a, b); }
+inline vfloat v_sub(vfloat a, vfloat b)       { return _mm_sub_ps(a, b); }
+inline vfloat v_mul(vfloat a, vfloat b)       { return _mm_mul_ps(a, b); }
+#ifdef __FMA__
+inline vfloat v_fmsub(vfloat a, vfloat b, vfloat c) { return _mm_fmsub_ps(a, b, c); }
+#endif
+inline vfloat v_min(vfloat a, vfloat b)       { return _mm_min_ps(a, b); }
+inline vfloat v_max(vfloat a, vfloat b)       { return _mm_max_ps(a, b); }
+
+inline void v_order_abs(vfloat a, vfloat b, vfloat& hi, vfloat& lo) {
+    vfloat sign = _mm_set1_ps(-0.0f);
+    vfloat ge = _mm_cmpge_ps(_mm_andnot_ps(sign, a), _mm_andnot_ps(sign, b));
+    hi = _mm_blendv_ps(b, a, ge);
+    lo = _mm_blendv_ps(a, b, ge);
+}
+
+#else
+
+// a single lane, so kernels written against vfloat still build everywhere
+#define EXP_SIMD_WIDTH 1
+
+typedef float vfloat;
+
+inline vfloat v_load(const float* p)          { return *p; }
+inline void   v_store(float* p, vfloat a)     { *p = a; }
+inline vfloat v_set1(float a)                 { return a; }
+inline vfloat v_add(vfloat a, vfloat b)       { return a + b; }
+inline vfloat v_sub(vfloat a, vfloat b)       { return a - b; }
+inline vfloat v_mul(vfloat a, vfloat b)       { return a * b; }
+#ifdef __FMA__
+inline vfloat v_fmsub(vfloat a, vfloat b, vfloat c) { return fmaf(a, b, -c); }
+#endif
+inline vfloat v_min(vfloat a, vfloat b)       { return a < b ? a : b; }
+inline vfloat v_max(vfloat a, vfloat b)       { return a < b ? b : a; }
+
+inline void v_order_abs(vfloat a, vfloat b, vfloat& hi, vfloat& lo) {
+    bool ge = fabsf(a) >= fabsf(b);
+    hi = ge ? a : b;
+    lo = ge ? b : a;
+}
+
+#endif
+
+inline void
+v_two_sum(vfloat a, vfloat b, vfloat& x, vfloat& y) {
+    vfloat av, bv, ar, br;
+
+    x = v_add(a, b);
+
+    bv = v_sub(x, a);
+    av = v_sub(x, bv);
+
+    br = v_sub(b, bv);
+    ar = v_sub(a, av);
+
+    y = v_add(ar, br);
+}
+
+// @brief Dekker's fast_two_sum, only valid for |a| >= |b|
+inline void
+v_quick_two_sum(vfloat a, vfloat b, vfloat& x, vfloat& y) {
+    x = v_add(a, b);
+    y = v_sub(b, v_sub(x, a));
+}
+
+// @brief fast_two_sum for any order of a and b, see fast_two_sum_select
+inline void
+v_fast_two_sum_select(vfloat a, vfloat b, vfloat& x, vfloat& y) {
+    vfloat hi, lo;
+
+    v_order_abs(a, b, hi, lo);
+    v_quick_two_sum(hi, lo, x, y);
+}
+
+inline void
+v_split (vfloat a, vfloat& a_hi, vfloat& a_lo) {
+    vfloat c, ab;
+
+    c = v_mul(v_set1(SPLIT_FLOAT), a);
+    ab = v_sub(c, a);
+    a_hi = v_sub(c, ab);
+    a_lo = v_sub(a, a_hi);
+}
+
+// with FMA the rounding error of a*b is recovered exactly in one instruction,
+// otherwise fall back to Dekker's split as in the scalar two_product.
+inline void
+v_two_product (vfloat a, vfloat b, vfloat& x, vfloat& y) {
+    x = v_mul(a, b);
+#if defined(__AVX512F__) || defined(__FMA__)
+    y = v_fmsub(a, b, x);
+#else
+    vfloat a_hi, a_lo, b_hi, b_lo, err1, err2;
+
+    v_split (a, a_hi, a_lo);
+    v_split (b, b_hi, b_lo);
+
+    err1 = v_sub(x, v_mul(a_hi, b_hi));
+    err2 = v_sub(err1, v_mul(a_lo, b_hi));
+    err1 = v_sub(err2, v_mul(a_hi, b_lo));
+
+    y = v_sub(v_mul(a_lo, b_lo), err1);
+#endif
+}
+
+inline void
+v_grow_expansion (vfloat& e1, vfloat& e2, vfloat b) {
+    vfloat q, h;
+
+    v_two_sum(b, e2, q, h);
+    v_two_sum(q, e1, e1, e2);
+}
+
+inline void
+v_scale_expansion (vfloat& e1, vfloat& e2, vfloat a) {
+    vfloat q, h, T, t;
+
+    v_two_product(e2, a, q, h);
+    v_two_product(e1, a, T, t);
+
+    v_two_sum(q, t, q, h);
+    v_two_sum(T, q, e1, e2);
+}
+
+// @brief (e1, e2) += (f1, f2); the low terms are combined in one rounding
+// and folded back with a final quick_two_sum, lane-wise quick_expansion_sum
+inline void
+v_expansion_sum (vfloat& e1, vfloat& e2, vfloat f1, vfloat f2) {
+    vfloat s, e;
+
+    v_two_sum(e1, f1, s, e);
+    e = v_add(e, v_add(e2, f2));
+    v_quick_two_sum(s, e, e1, e2);
+}
+
+// @brief lane-wise fast_expansion_sum_select
+inline void
+v_fast_expansion_sum_select (vfloat& e1, vfloat& e2, vfloat f1, vfloat f2) {
+    vfloat q, h, g, x, y;
+    vfloat lo = v_min(e1, f1), hi = v_max(e1, f1);
+
+    v_two_sum(f2, e2, q, h);
+    v_two_sum(q, lo, q, g);
+    v_two_sum(q, hi, x, y);
+
+    v_fast_two_sum_select(x, v_add(y, v_add(g, h)), e1, e2);
+}
+
+// @brief collapse the per-lane expansions into a single (r1,r2), always in lane
+// order so the result does not depend on anything but the input.
+inline void
+v_reduce_expansion (vfloat e1, vfloat e2, float& r1, float& r2) {
+    float l1[EXP_SIMD_WIDTH], l2[EXP_SIMD_WIDTH];
+
+    v_store(l1, e1);
+    v_store(l2, e2);
+
+    merge_lanes<EXP_SIMD_WIDTH>(l1, l2, r1, r2);
+}
+
+// @brief element-wise x[i] + y[i] = a[i] + b[i]
+inline void
+two_sum_array (const float* a, const float* b, float* x, float* y, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat vx, vy;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v_two_sum(v_load(a + i), v_load(b + i), vx, vy);
+        v_store(x + i, vx);
+        v_store(y + i, vy);
+    }
+#endif
+    for (; i < n; ++i)
+        two_sum(a[i], b[i], x[i], y[i]);
+}
+
+// @brief element-wise x[i] + y[i] = a[i] + b[i], with the branch-free fast_two_sum
+inline void
+fast_two_sum_array (const float* a, const float* b, float* x, float* y, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat vx, vy;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v_fast_two_sum_select(v_load(a + i), v_load(b + i), vx, vy);
+        v_store(x + i, vx);
+        v_store(y + i, vy);
+    }
+#endif
+    for (; i < n; ++i)
+        fast_two_sum_select(a[i], b[i], x[i], y[i]);
+}
+
+// @brief element-wise x[i] + y[i] = a[i] * b[i]
+inline void
+two_product_array (const float* a, const float* b, float* x, float* y, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat vx, vy;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v_two_product(v_load(a + i), v_load(b + i), vx, vy);
+        v_store(x + i, vx);
+        v_store(y + i, vy);
+    }
+#endif
+    for (; i < n; ++i)
+        two_product(a[i], b[i], x[i], y[i]);
+}
+
+// @brief element-wise (e1[i], e2[i]) += b[i]
+inline void
+grow_expansion_array (float* e1, float* e2, const float* b, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat v1, v2;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v1 = v_load(e1 + i);
+        v2 = v_load(e2 + i);
+        v_grow_expansion(v1, v2, v_load(b + i));
+        v_store(e1 + i, v1);
+        v_store(e2 + i, v2);
+    }
+#endif
+    for (; i < n; ++i)
+        grow_expansion(e1[i], e2[i], b[i]);
+}
+
+// @brief element-wise (e1[i], e2[i]) += (f1[i], f2[i]), branch-free
+inline void
+fast_expansion_sum_array (float* e1, float* e2, const float* f1, const float* f2, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat v1, v2;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v1 = v_load(e1 + i);
+        v2 = v_load(e2 + i);
+        v_fast_expansion_sum_select(v1, v2, v_load(f1 + i), v_load(f2 + i));
+        v_store(e1 + i, v1);
+        v_store(e2 + i, v2);
+    }
+#endif
+    for (; i < n; ++i)
+        fast_expansion_sum_select(e1[i], e2[i], f1[i], f2[i]);
+}
+
+// @brief element-wise (e1[i], e2[i]) *= a
+inline void
+scale_expansion_array (float* e1, float* e2, float a, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat v1, v2, va = v_set1(a);
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v1 = v_load(e1 + i);
+        v2 = v_load(e2 + i);
+        v_scale_expansion(v1, v2, va);
+        v_store(e1 + i, v1);
+        v_store(e2 + i, v2);
+    }
+#endif
+    for (; i < n; ++i)
+        scale_expansion(e1 + i, e2 + i, a);
+}
+
+// @brief element-wise (e1[i], e2[i]) = a * (e1[i], e2[i]) + b[i], as daxpy
+inline void
+daxpy_array (float* e1, float* e2, float a, const float* b, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat v1, v2, va = v_set1(a);
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v1 = v_load(e1 + i);
+        v2 = v_load(e2 + i);
+        v_scale_expansion(v1, v2, va);
+        v_grow_expansion(v1, v2, v_load(b + i));
+        v_store(e1 + i, v1);
+        v_store(e2 + i, v2);
+    }
+#endif
+    for (; i < n; ++i)
+        daxpy(e1 + i, e2 + i, a, b[i]);
+}
+
+// @brief element-wise (e1[i], e2[i]) += a[i] * s, keeping the product error
+inline void
+exp_axpy_array (float* e1, float* e2, const float* a, float s, unsigned long n) {
+    unsigned long i = 0;
+    float x, y;
+#if EXP_SIMD_WIDTH > 1
+    vfloat v1, v2, vx, vy, vs = v_set1(s);
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v1 = v_load(e1 + i);
+        v2 = v_load(e2 + i);
+        v_two_product(v_load(a + i), vs, vx, vy);
+        v_grow_expansion(v1, v2, vx);
+        v_grow_expansion(v1, v2, vy);
+        v_store(e1 + i, v1);
+        v_store(e2 + i, v2);
+    }
+#endif
+    for (; i < n; ++i) {
+        two_product(a[i], s, x, y);
+        grow_expansion(e1[i], e2[i], x);
+        grow_expansion(e1[i], e2[i], y);
+    }
+}
+
+// @brief sum of a[0..n) in expansion form, one accumulator per SIMD lane
+inline void
+exp_sum_simd (const float* a, unsigned long n, float& r1, float& r2) {
+    unsigned long i = 0;
+    r1 = 0.0; r2 = 0.0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat e1 = v_set1(0.0f), e2 = v_set1(0.0f);
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH)
+        v_grow_expansion(e1, e2, v_load(a + i));
+    v_reduce_expansion(e1, e2, r1, r2);
+#endif
+    for (; i < n; ++i)
+        grow_expansion(r1, r2, a[i]);
+}
+
+// @brief dot product in expansion form; unlike exp_dot the rounding error of
+// each product is kept (two_product) and accumulated as well.
+inline void
+exp_dot_simd (const float* a, const float* b, unsigned long n, float& r1, float& r2) {
+    unsigned long i = 0;
+    float x, y;
+    r1 = 0.0; r2 = 0.0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat e1 = v_set1(0.0f), e2 = v_set1(0.0f), vx, vy;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        v_two_product(v_load(a + i), v_load(b + i), vx, vy);
+        v_grow_expansion(e1, e2, vx);
+        v_grow_expansion(e1, e2, vy);
+    }
+    v_reduce_expansion(e1, e2, r1, r2);
+#endif
+    for (; i < n; ++i) {
+        two_product(a[i], b[i], x, y);
+        grow_expansion(r1, r2, x);
+        grow_expansion(r1, r2, y);
+    }
+}
+
+// ---- polynomial evaluation over arrays of points -----------------------------
+//
+// p(x) = a[0] + a[1] x + ... + a[degree] x^degree at every x[i], vectorized
+// across the points: one lane per point, the coefficients broadcast. Degrees
+// up to EXP_HORNER_FIXED go to a specialization with the coefficients in
+// registers and the Horner loop fully unrolled.
+
+#define EXP_HORNER_FIXED 16
+
+// @brief one step s = s x + a of compensated Horner, lane-wise; the rounding
+// errors of the step are accumulated into c by the second recurrence
+inline void
+v_comp_horner_step (vfloat& s, vfloat& c, vfloat x, vfloat a) {
+    vfloat p, pi, sigma;
+
+    v_two_product(s, x, p, pi);
+    v_two_sum(p, a, s, sigma);
+    c = v_add(v_mul(c, x), v_add(pi, sigma));
+}
+
+// @brief y[i] = p(x[i]) by Horner's rule, for a degree known at compile time
+template <int D>
+inline void
+horner_array_fixed (const float* a, const float* x, float* y, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat va[D + 1], vx, vs;
+    for (int k = 0; k <= D; ++k)
+        va[k] = v_set1(a[k]);
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        vx = v_load(x + i);
+        vs = va[D];
+        EXP_UNROLL
+        for (int k = D - 1; k >= 0; --k)
+            vs = v_add(v_mul(vs, vx), va[k]);
+        v_store(y + i, vs);
+    }
+#endif
+    for (; i < n; ++i)
+        y[i] = horner(a, D, x[i]);
+}
+
+// @brief (r1[i], r2[i]) = p(x[i]) by compensated Horner, for a degree known
+// at compile time
+template <int D>
+inline void
+comp_horner_array_fixed (const float* a, const float* x, float* r1, float* r2, unsigned long n) {
+    unsigned long i = 0;
+#if EXP_SIMD_WIDTH > 1
+    vfloat va[D + 1], vx, vs, vc, v1, v2;
+    for (int k = 0; k <= D; ++k)
+        va[k] = v_set1(a[k]);
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        vx = v_load(x + i);
+        vs = va[D];
+        vc = v_set1(0.0f);
+        EXP_UNROLL
+        for (int k = D - 1; k >= 0; --k)
+            v_comp_horner_step(vs, vc, vx, va[k]);
+        v_fast_two_sum_select(vs, vc, v1, v2);
+        v_store(r1 + i, v1);
+        v_store(r2 + i, v2);
+    }
+#endif
+    for (; i < n; ++i)
+        comp_horner(a, D, x[i], r1[i], r2[i]);
+}
+
+// @brief run horner_array_fixed<degree> if degree is in 1..D, otherwise
+// return false
+template <int D>
+inline bool
+horner_array_select (int degree, const float* a, const float* x, float* y, unsigned long n) {
+    if (degree == D) {
+        horner_array_fixed<D>(a, x, y, n);
+        return true;
+    }
+    return horner_array_select<D - 1>(degree, a, x, y, n);
+}
+
+template <>
+inline bool
+horner_array_select<0> (int, const float*, const float*, float*, unsigned long) {
+    return false;
+}
+
+// @brief run comp_horner_array_fixed<degree> if degree is in 1..D
+template <int D>
+inline bool
+comp_horner_array_select (int degree, const float* a, const float* x, float* r1, float* r2, unsigned long n) {
+    if (degree == D) {
+        comp_horner_array_fixed<D>(a, x, r1, r2, n);
+        return true;
+    }
+    return comp_horner_array_select<D - 1>(degree, a, x, r1, r2, n);
+}
+
+template <>
+inline bool
+comp_horner_array_select<0> (int, const float*, const float*, float*, float*, unsigned long) {
+    return false;
+}
+
+// @brief y[i] = p(x[i]) by Horner's rule, the float baseline
+inline void
+horner_array (const float* a, int degree, const float* x, float* y, unsigned long n) {
+    unsigned long i = 0;
+    if (horner_array_select<EXP_HORNER_FIXED>(degree, a, x, y, n))
+        return;
+#if EXP_SIMD_WIDTH > 1
+    vfloat vx, vs;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        vx = v_load(x + i);
+        vs = v_set1(a[degree]);
+        for (int k = degree - 1; k >= 0; --k)
+            vs = v_add(v_mul(vs, vx), v_set1(a[k]));
+        v_store(y + i, vs);
+    }
+#endif
+    for (; i < n; ++i)
+        y[i] = horner(a, degree, x[i]);
+}
+
+// @brief (r1[i], r2[i]) = p(x[i]) by compensated Horner, see comp_horner
+inline void
+comp_horner_array (const float* a, int degree, const float* x, float* r1, float* r2, unsigned long n) {
+    unsigned long i = 0;
+    if (comp_horner_array_select<EXP_HORNER_FIXED>(degree, a, x, r1, r2, n))
+        return;
+#if EXP_SIMD_WIDTH > 1
+    vfloat vx, vs, vc, v1, v2;
+    for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+        vx = v_load(x + i);
+        vs = v_set1(a[degree]);
+        vc = v_set1(0.0f);
+        for (int k = degree - 1; k >= 0; --k)
+            v_comp_horner_step(vs, vc, vx, v_set1(a[k]));
+        v_fast_two_sum_select(vs, vc, v1, v2);
+        v_store(r1 + i, v1);
+        v_store(r2 + i, v2);
+    }
+#endif
+    for (; i < n; ++i)
+        comp_horner(a, degree, x[i], r1[i], r2[i]);
+}
+
+#endif //EXPFLOAT_EXPANSION_SIMD_H
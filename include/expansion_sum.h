@@ -0,0 +1,157 @@
+//
+// Summation strategies for float arrays, from the naive loop to expansions.
+//
+// Every strategy has the signature of exp_sum: the sum of a[0..n) is returned
+// as r1 + r2, where r2 is whatever the strategy keeps beyond one float (the
+// compensation, the low word of a double, the second expansion term) and 0
+// if it keeps nothing. sum_strategies() lists them by name so that a caller
+// can run all of them on the same data; more are plugged in by appending to
+// it. Apart from expansion_simd (the dispatched exp_sum) they are the plain
+// scalar loops, so their speed is that of the loop-carried dependence each
+// one has.
+//
+
+#ifndef EXPFLOAT_EXPANSION_SUM_H
+#define EXPFLOAT_EXPANSION_SUM_H
+
+#include <math.h>
+#include <vector>
+
+#include <expansion_math.h>
+#include <expansion_dispatch.h>
+
+// leaves of the pairwise recursion, summed with the naive loop
+#define EXP_PAIRWISE_BASE 128
+
+// blocks of sum_blocked, each summed with the naive loop
+#define EXP_SUM_BLOCK 1024
+
+typedef void (*sum_fn)(const float* a, unsigned long n, float& r1, float& r2);
+
+struct SumStrategy {
+    const char* name;
+    sum_fn sum;
+};
+
+// @brief left to right in float, error up to (n - 1) u sum |a_i|
+inline void sum_naive(const float* a, unsigned long n, float& r1, float& r2) {
+    float s = 0.0f;
+    for (unsigned long i = 0; i < n; ++i)
+        s = s + a[i];
+    r1 = s; r2 = 0.0f;
+}
+
+// @brief left to right in double, error up to (n - 1) 2^-53 sum |a_i|
+inline void sum_double(const float* a, unsigned long n, float& r1, float& r2) {
+    double s = 0.0;
+    for (unsigned long i = 0; i < n; ++i)
+        s = s + a[i];
+    r1 = (float)s; r2 = (float)(s - r1);
+}
+
+// @brief Kahan: the rounding error of each addition is subtracted from the
+// next summand; error about 2u sum |a_i| as long as n u < 1
+inline void sum_kahan(const float* a, unsigned long n, float& r1, float& r2) {
+    float s = 0.0f, c = 0.0f, y, t;
+    for (unsigned long i = 0; i < n; ++i) {
+        y = a[i] - c;
+        t = s + y;
+        c = (t - s) - y;
+        s = t;
+    }
+    r1 = s; r2 = 0.0f;
+}
+
+// @brief Neumaier: Kahan with the larger of s and a_i taken as the leading
+// term, and the errors added at the end, so a summand larger than the running
+// sum does not lose the compensation
+inline void sum_neumaier(const float* a, unsigned long n, float& r1, float& r2) {
+    float s = 0.0f, c = 0.0f, t;
+    for (unsigned long i = 0; i < n; ++i) {
+        t = s + a[i];
+        c += fabsf(s) >= fabsf(a[i]) ? (s - t) + a[i] : (a[i] - t) + s;
+        s = t;
+    }
+    r1 = s; r2 = c;
+}
+
+// @brief cascaded summation (Sum2 of Ogita, Rump & Oishi): the exact error of
+// every addition by two_sum, without a branch, summed in a second float;
+// as accurate as the naive sum in twice the precision
+inline void sum_cascaded(const float* a, unsigned long n, float& r1, float& r2) {
+    float s = 0.0f, c = 0.0f, q;
+    for (unsigned long i = 0; i < n; ++i) {
+        two_sum(s, a[i], s, q);
+        c += q;
+    }
+    fast_two_sum_select(s, c, r1, r2);
+}
+
+// @brief the naive sum of a[0..n) split in halves down to EXP_PAIRWISE_BASE
+// elements; error grows with log2 n instead of n
+inline float sum_pairwise_rec(const float* a, unsigned long n) {
+    if (n <= EXP_PAIRWISE_BASE) {
+        float s = 0.0f;
+        for (unsigned long i = 0; i < n; ++i)
+            s = s + a[i];
+        return s;
+    }
+    unsigned long h = n / 2;
+    return sum_pairwise_rec(a, h) + sum_pairwise_rec(a + h, n - h);
+}
+
+inline void sum_pairwise(const float* a, unsigned long n, float& r1, float& r2) {
+    r1 = sum_pairwise_rec(a, n); r2 = 0.0f;
+}
+
+// @brief blocks of EXP_SUM_BLOCK summed naively, then the block sums;
+// error up to (EXP_SUM_BLOCK + n / EXP_SUM_BLOCK) u sum |a_i|
+inline void sum_blocked(const float* a, unsigned long n, float& r1, float& r2) {
+    float s = 0.0f, b;
+    for (unsigned long i = 0; i < n; i += EXP_SUM_BLOCK) {
+        b = 0.0f;
+        for (unsigned long j = i; j < n && j < i + EXP_SUM_BLOCK; ++j)
+            b = b + a[j];
+        s = s + b;
+    }
+    r1 = s; r2 = 0.0f;
+}
+
+// @brief grow_expansion over a, in K interleaved expansions, see exp_sum_lanes
+template <int K>
+inline void sum_expansion(const float* a, unsigned long n, float& r1, float& r2) {
+    if (K == 1) {
+        r1 = 0.0f; r2 = 0.0f;
+        for (unsigned long i = 0; i < n; ++i)
+            grow_expansion(r1, r2, a[i]);
+    } else {
+        exp_sum_lanes<K>(a, n, r1, r2);
+    }
+}
+
+// @brief exp_sum of the kernels selected for this CPU
+inline void sum_expansion_simd(const float* a, unsigned long n, float& r1, float& r2) {
+    exp_kernels().exp_sum(a, n, r1, r2);
+}
+
+// @brief all strategies: the plain loops, the compensated ones, then the
+// expansions; append to the list to compare more
+inline std::vector<SumStrategy>& sum_strategies() {
+    static std::vector<SumStrategy> s = {
+        {"float", sum_naive},
+        {"pairwise", sum_pairwise},
+        {"blocked", sum_blocked},
+        {"double", sum_double},
+        {"kahan", sum_kahan},
+        {"neumaier", sum_neumaier},
+        {"cascaded", sum_cascaded},
+        {"expansion", sum_expansion<1>},
+        {"expansion_4", sum_expansion<4>},
+        {"expansion_8", sum_expansion<8>},
+        {"expansion_16", sum_expansion<16>},
+        {"expansion_simd", sum_expansion_simd},
+    };
+    return s;
+}
+
+#endif //EXPFLOAT_EXPANSION_SUM_H
@@ -0,0 +1,414 @@
+//
+// Streaming, chunked HfpCodec files for data larger than memory.
+//
+// hfp_encode_stream() pulls values from a source in chunks of `chunk` values
+// (a multiple of HFP_BLOCK), encodes every chunk on its own and appends it to
+// a file; hfp_decode_stream() reads the chunks back and hands the decoded
+// values to a sink. Both are three-stage pipelines connected by bounded
+// queues,
+//
+//     encode:  source thread -> encoder (calling thread) -> writer thread
+//     decode:  reader thread -> decoder (calling thread) -> sink thread
+//
+// so reading and writing overlap with the coding, and at most
+// HFP_STREAM_DEPTH chunks are in flight between two stages: memory use is a
+// few chunks whatever the size of the data. Raw chunk buffers are recycled.
+//
+// File layout, all little endian as written by the host:
+//
+//     HfpFileHeader
+//     per chunk:  uint64 n, uint64 bytes, uint64 offsets[blocks + 1], bytes of blocks
+//
+// n in the header is written last, after the final chunk.
+//
+
+#ifndef EXPFLOAT_HFP_STREAM_H
+#define EXPFLOAT_HFP_STREAM_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <utils.h>
+#include <hierarchical.h>
+
+#define HFP_STREAM_CHUNK (1024 * HFP_BLOCK)
+#define HFP_STREAM_DEPTH 4
+
+// largest chunk in bytes of values; the decoder rejects files with larger ones
+// so a corrupt header cannot make it allocate more than HFP_STREAM_DEPTH of them
+#define HFP_STREAM_CHUNK_BYTES_MAX (256ul << 20)
+
+struct HfpFileHeader {
+    char magic[4];          // "HFPS"
+    uint32_t value_size;    // sizeof(H): 16 for __float128, 8 for double
+    uint64_t n;             // number of values
+    uint64_t chunk;         // values per chunk, all but the last
+    double tol;             // tolerance the values were encoded with
+};
+
+struct HfpStreamStats {
+    unsigned long n;            // values
+    unsigned long chunks;
+    uint64_t raw_bytes;         // n * sizeof(H)
+    uint64_t file_bytes;
+    uint64_t ticks;             // timer_ticks() for the whole pipeline
+
+    double ratio() const { return file_bytes ? (double)raw_bytes / file_bytes : 0.0; }
+    double gbps() const { return ticks ? raw_bytes / timer_seconds(ticks) * 1e-9 : 0.0; }
+};
+
+// @brief bounded blocking queue between two pipeline stages; pop() returns
+// false once the queue is closed and drained
+template <typename T>
+class HfpChannel {
+public:
+    explicit HfpChannel(size_t cap) : m_cap(cap), m_closed(false) {}
+
+    void push(T&& x) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this] { return m_queue.size() < m_cap; });
+        m_queue.push_back(std::move(x));
+        m_not_empty.notify_one();
+    }
+
+    bool pop(T& x) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return !m_queue.empty() || m_closed; });
+        if (m_queue.empty())
+            return false;
+        x = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_not_empty.notify_all();
+    }
+
+private:
+    size_t m_cap;
+    bool m_closed;
+    std::deque<T> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_not_full, m_not_empty;
+};
+
+// @brief a chunk on its way through the pipeline, raw or encoded
+template <typename H>
+struct HfpChunk {
+    unsigned long first, n;
+    std::vector<H> values;
+    std::vector<unsigned char> data;
+    std::vector<uint64_t> offsets;
+};
+
+template <typename H>
+using HfpSource = std::function<unsigned long (H* buf, unsigned long max)>;
+
+template <typename H>
+using HfpSink = std::function<void (const H* v, unsigned long n, unsigned long first)>;
+
+// @brief encode everything source produces (it returns the number of values
+// written to buf, 0 at the end) into the file path. Returns false with errno
+// set if the file cannot be written; source is not called again after the
+// first failed write. An exception in a pipeline stage (bad_alloc, or thrown
+// by source) also ends the encoding, with EINVAL, instead of terminating.
+template <typename H>
+bool hfp_encode_stream(const HfpSource<H>& source, const char* path, H tol, HfpStreamStats& stats,
+                       unsigned long chunk = HFP_STREAM_CHUNK) {
+    HfpFileHeader hdr;
+    FILE* f = fopen(path, "wb");
+    std::atomic<bool> ok(true);
+    std::atomic<int> err(0);
+
+    if (!f)
+        return false;
+    chunk = std::min(chunk, HFP_STREAM_CHUNK_BYTES_MAX / sizeof(H));
+    chunk = std::max(chunk / HFP_BLOCK, 1ul) * HFP_BLOCK;
+    memcpy(hdr.magic, "HFPS", 4);
+    hdr.value_size = sizeof(H);
+    hdr.n = 0;
+    hdr.chunk = chunk;
+    hdr.tol = (double)tol;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+        ok = false;
+        err = errno;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.file_bytes = sizeof(hdr);
+    uint64_t t0 = timer_ticks();
+
+    HfpChannel<HfpChunk<H> > free_chunks(HFP_STREAM_DEPTH), raw(HFP_STREAM_DEPTH), encoded(HFP_STREAM_DEPTH);
+    try {
+        for (int k = 0; k < HFP_STREAM_DEPTH; ++k) {
+            HfpChunk<H> c;
+            c.values.resize(chunk);
+            free_chunks.push(std::move(c));
+        }
+    } catch (...) {
+        fclose(f);
+        errno = ENOMEM;
+        return false;
+    }
+
+    // the reader stops pulling the source as soon as a later stage fails
+    std::thread reader([&] {
+        try {
+            HfpChunk<H> c;
+            unsigned long first = 0;
+            while (ok && free_chunks.pop(c)) {
+                c.first = first;
+                c.n = 0;
+                // fill the chunk completely, so only the last one is short
+                while (ok && c.n < chunk) {
+                    unsigned long got = source(&c.values[c.n], chunk - c.n);
+                    if (!got)
+                        break;
+                    c.n += got;
+                }
+                if (!c.n)
+                    break;
+                first += c.n;
+                bool last = c.n < chunk;
+                raw.push(std::move(c));
+                if (last)
+                    break;
+            }
+        } catch (...) {
+            ok = false;
+            err = EINVAL;
+        }
+        raw.close();
+    });
+
+    std::thread writer([&] {
+        HfpChunk<H> c;
+        while (encoded.pop(c)) {
+            uint64_t head[2] = {c.n, c.data.size()};
+            if (!ok)
+                continue;
+            if (fwrite(head, sizeof(head), 1, f) != 1
+                || fwrite(&c.offsets[0], sizeof(uint64_t), c.offsets.size(), f) != c.offsets.size()
+                || fwrite(&c.data[0], 1, c.data.size(), f) != c.data.size()) {
+                ok = false;
+                err = errno;
+                continue;
+            }
+            stats.file_bytes += sizeof(head) + c.offsets.size() * sizeof(uint64_t) + c.data.size();
+            stats.n += c.n;
+            stats.chunks++;
+        }
+    });
+
+    // after a failure the loop only drains raw, so the reader can finish
+    HfpCodec<H> codec(tol);
+    HfpChunk<H> c;
+    while (raw.pop(c)) {
+        if (ok) {
+            try {
+                HfpChunk<H> e;
+                codec.encode(&c.values[0], c.n);
+                e.first = c.first;
+                e.n = c.n;
+                e.data = codec.data();
+                e.offsets = codec.offsets();
+                encoded.push(std::move(e));
+            } catch (...) {
+                ok = false;
+                err = EINVAL;
+            }
+        }
+        free_chunks.push(std::move(c));
+    }
+    // unblocks the reader if it is waiting for a buffer after an early end
+    free_chunks.close();
+    encoded.close();
+    reader.join();
+    writer.join();
+
+    hdr.n = stats.n;
+    if (ok && (fseek(f, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, f) != 1)) {
+        ok = false;
+        err = errno;
+    }
+    if (fclose(f) != 0 && ok) {
+        ok = false;
+        err = errno;
+    }
+
+    stats.raw_bytes = stats.n * sizeof(H);
+    stats.ticks = timer_ticks() - t0;
+    if (!ok)
+        errno = err.load() ? err.load() : EIO;
+    return ok;
+}
+
+// @brief decode the file path chunk by chunk into sink, which gets the values
+// in order, with the index of the first one. Returns false if the file cannot
+// be read or is not an HfpCodec<H> stream, with errno set: EINVAL for a bad
+// header or a corrupt chunk (offsets out of order or out of range, blocks
+// that do not match their tags), EIO for a truncated file or a chunk that
+// runs past its end. Nothing in the file is trusted before it has been
+// checked, and an exception in a pipeline stage (bad_alloc, or thrown by
+// sink) also ends the decoding with EINVAL instead of terminating.
+template <typename H>
+bool hfp_decode_stream(const char* path, const HfpSink<H>& sink, HfpStreamStats& stats, HfpFileHeader* header = NULL) {
+    HfpFileHeader hdr;
+    FILE* f = fopen(path, "rb");
+    struct stat st;
+    std::atomic<bool> ok(true);
+    std::atomic<int> err(0);
+
+    if (!f)
+        return false;
+    if (fstat(fileno(f), &st) != 0) {
+        fclose(f);
+        return false;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, "HFPS", 4) != 0 || hdr.value_size != sizeof(H)
+        || hdr.chunk == 0 || hdr.chunk % HFP_BLOCK != 0 || hdr.chunk > HFP_STREAM_CHUNK_BYTES_MAX / sizeof(H)) {
+        fclose(f);
+        errno = EINVAL;
+        return false;
+    }
+    if (header)
+        *header = hdr;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.file_bytes = sizeof(hdr);
+    uint64_t t0 = timer_ticks();
+
+    HfpChannel<HfpChunk<H> > encoded(HFP_STREAM_DEPTH), free_chunks(HFP_STREAM_DEPTH), decoded(HFP_STREAM_DEPTH);
+    try {
+        for (int k = 0; k < HFP_STREAM_DEPTH; ++k) {
+            HfpChunk<H> c;
+            c.values.resize(hdr.chunk);
+            free_chunks.push(std::move(c));
+        }
+    } catch (...) {
+        fclose(f);
+        errno = ENOMEM;
+        return false;
+    }
+
+    // the reader stops at the first bad chunk; err tells why, EIO (short
+    // read) unless set otherwise
+    std::thread reader([&] {
+        try {
+            unsigned long first = 0;
+            uint64_t pos = sizeof(hdr);
+            while (ok && first < hdr.n) {
+                HfpChunk<H> c;
+                uint64_t head[2];
+                if (fread(head, sizeof(head), 1, f) != 1) {
+                    ok = false;
+                    break;
+                }
+                pos += sizeof(head);
+                uint64_t index = ((head[0] + HFP_BLOCK - 1) / HFP_BLOCK + 1) * sizeof(uint64_t);
+                if (head[0] == 0 || head[0] > hdr.chunk || head[0] > hdr.n - first) {
+                    ok = false;
+                    err = EINVAL;
+                    break;
+                }
+                // a chunk that runs past the end of the file: truncated
+                if (index > (uint64_t)st.st_size - pos || head[1] > (uint64_t)st.st_size - pos - index) {
+                    ok = false;
+                    err = EIO;
+                    break;
+                }
+                c.first = first;
+                c.n = head[0];
+                c.offsets.resize(index / sizeof(uint64_t));
+                c.data.resize(head[1]);
+                if (fread(&c.offsets[0], sizeof(uint64_t), c.offsets.size(), f) != c.offsets.size()
+                    || fread(c.data.data(), 1, c.data.size(), f) != c.data.size()) {
+                    ok = false;
+                    break;
+                }
+                bool sorted = true;
+                for (size_t k = 0; k + 1 < c.offsets.size() && sorted; ++k)
+                    sorted = c.offsets[k] <= c.offsets[k + 1];
+                if (!sorted || c.offsets[0] != 0 || c.offsets.back() != c.data.size()) {
+                    ok = false;
+                    err = EINVAL;
+                    break;
+                }
+                pos += index + c.data.size();
+                stats.file_bytes += sizeof(head) + index + c.data.size();
+                first += c.n;
+                encoded.push(std::move(c));
+            }
+        } catch (...) {
+            ok = false;
+            err = EINVAL;
+        }
+        encoded.close();
+    });
+
+    std::thread consumer([&] {
+        HfpChunk<H> c;
+        while (decoded.pop(c)) {
+            if (ok) {
+                try {
+                    sink(&c.values[0], c.n, c.first);
+                } catch (...) {
+                    ok = false;
+                    err = EINVAL;
+                }
+            }
+            stats.n += c.n;
+            stats.chunks++;
+            free_chunks.push(std::move(c));
+        }
+    });
+
+    // a bad chunk is not decoded, but the loop goes on draining encoded so
+    // the reader can finish
+    HfpCodec<H> codec((H)hdr.tol);
+    HfpChunk<H> e, c;
+    while (encoded.pop(e)) {
+        if (!ok || !free_chunks.pop(c))
+            continue;
+        c.first = e.first;
+        c.n = e.n;
+        codec.assign(e.n, e.data, e.offsets);
+        if (!codec.valid()) {
+            ok = false;
+            err = EINVAL;
+            free_chunks.push(std::move(c));
+            continue;
+        }
+        codec.decode(&c.values[0]);
+        decoded.push(std::move(c));
+    }
+    decoded.close();
+    reader.join();
+    consumer.join();
+    fclose(f);
+
+    stats.raw_bytes = stats.n * sizeof(H);
+    stats.ticks = timer_ticks() - t0;
+    if (ok && stats.n != hdr.n)
+        ok = false;
+    if (!ok)
+        errno = err.load() ? err.load() : EIO;
+    return ok;
+}
+
+#endif //EXPFLOAT_HFP_STREAM_H
@@ -0,0 +1,287 @@
+//
+// Hierarchical floating point: storing a high precision sequence as lower
+// precision base values plus residuals.
+//
+// HfpCodec<H> encodes an array of H (__float128 or double) as a stream over
+// the next lower type L (double or float). Every value is predicted from the
+// two values decoded before it, base = r[i-1] + (r[i-1] - r[i-2]), and only
+// the residual v - base is stored, as the fewest L terms that bring the
+// decoded value within tol of v:
+//
+//     tag 0   base                 nothing stored
+//     tag 1   base + t1            one L term
+//     tag 2   base + (t1 + t2)     two L terms, the second the residual of the first
+//     tag 3   v                    the H value itself, for anything else
+//
+// tol = 0 is lossless, bit for bit. The elements are grouped in blocks of
+// HFP_BLOCK; the prediction restarts at every block (the first value uses
+// base 0, the second r[i-1]), so any block decodes on its own and get(i) only
+// walks its block. A block is its 2-bit tags followed by the terms and raw
+// values in element order; m_offset indexes the blocks in the byte stream.
+// Base and residual are only ever added, never multiplied, so no FMA
+// contraction can make the decoder round differently from the encoder.
+//
+
+#ifndef EXPFLOAT_HIERARCHICAL_H
+#define EXPFLOAT_HIERARCHICAL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#define HFP_BLOCK 1024
+
+// @brief number of doubles needed to store the quad values v[0..n) as deltas:
+// a delta whose double rounding matches the previous base (to 1e-16) only
+// costs a residual, otherwise a new base and a residual are stored.
+inline unsigned long
+hfp_count (const __float128* v, unsigned long n) {
+    double d, d_prev;
+    unsigned long cnt;
+
+    d = static_cast<double> ( v[0] );
+    cnt = 2;
+    d_prev = d;
+    for (unsigned long i=1; i<n; ++i) {
+        d = static_cast<double> ( v[i] - v[i-1]);
+        if ( fabs(d-d_prev) < 1e-16 ) {
+            cnt++;
+        } else {
+            d_prev = d;
+            cnt+=2;
+        }
+    }
+    return cnt;
+}
+
+// @brief number of floats needed to store the double values v[0..n) as
+// deltas, as above with a 1e-8 threshold
+inline unsigned long
+hfp_count (const double* v, unsigned long n) {
+    float f, f_prev;
+    unsigned long cnt;
+
+    f = static_cast<float> ( v[0] );
+    cnt = 2;
+    f_prev = f;
+    for (unsigned long i=1; i<n; ++i) {
+        f = static_cast<float> ( v[i] - v[i-1]);
+        if ( fabs(f-f_prev) < 1e-8 ) {
+            cnt++;
+        } else {
+            f_prev = f;
+            cnt+=2;
+        }
+    }
+    return cnt;
+}
+
+// @brief the type the residuals of H are stored in
+template <typename H> struct hfp_traits;
+template <> struct hfp_traits<__float128> { typedef double low; };
+template <> struct hfp_traits<double>     { typedef float low; };
+
+template <typename H>
+class HfpCodec {
+public:
+    typedef typename hfp_traits<H>::low L;
+
+    enum { TAG_BASE, TAG_ONE, TAG_TWO, TAG_RAW };
+
+    // @param tol  largest absolute error of a decoded value, 0 for lossless
+    explicit HfpCodec(H tol = 0) : m_n(0), m_tol(tol) {
+        m_offset.push_back(0);
+        for (int t = 0; t < 4; ++t)
+            m_count[t] = 0;
+    }
+
+    unsigned long size() const { return m_n; }
+    unsigned long blocks() const { return m_offset.size() - 1; }
+    H tolerance() const { return m_tol; }
+
+    // @brief bytes of the encoded stream and its block index
+    unsigned long bytes() const { return m_data.size() + m_offset.size() * sizeof(uint64_t); }
+
+    // @brief raw bytes over encoded bytes
+    double ratio() const { return bytes() ? (double)m_n * sizeof(H) / bytes() : 0.0; }
+
+    // @brief number of values stored with tag t
+    unsigned long count(int t) const { return m_count[t]; }
+
+    // @brief the encoded blocks, as a byte stream and the offset of every block in it
+    const std::vector<unsigned char>& data() const { return m_data; }
+    const std::vector<uint64_t>& offsets() const { return m_offset; }
+
+    // @brief replace the stream with the encoding of v[0..n)
+    void encode(const H* v, unsigned long n) {
+        m_n = 0;
+        m_data.clear();
+        m_offset.assign(1, 0);
+        for (int t = 0; t < 4; ++t)
+            m_count[t] = 0;
+        append(v, n);
+    }
+
+    // @brief take over an encoded stream of n values, e.g. one read back from
+    // a file; the tag counts are not known and read as zero
+    void assign(unsigned long n, std::vector<unsigned char>& data, std::vector<uint64_t>& offsets) {
+        m_n = n;
+        m_data.swap(data);
+        m_offset.swap(offsets);
+        for (int t = 0; t < 4; ++t)
+            m_count[t] = 0;
+    }
+
+    // @brief the stream is well formed: an offset per block and one for the
+    // end, non-decreasing up to the size of the data, and every block exactly
+    // as long as its tags say, so decoding never reads outside it
+    bool valid() const {
+        if (m_offset.size() != (m_n + HFP_BLOCK - 1) / HFP_BLOCK + 1 || m_offset[0] != 0
+            || m_offset.back() != m_data.size())
+            return false;
+        for (unsigned long kb = 0; kb + 1 < m_offset.size(); ++kb) {
+            if (m_offset[kb + 1] < m_offset[kb])
+                return false;
+            unsigned long len = block_size(kb);
+            uint64_t have = m_offset[kb + 1] - m_offset[kb], need = tag_bytes(len);
+            if (have < need)
+                return false;
+            const unsigned char* tags = &m_data[m_offset[kb]];
+            for (unsigned long j = 0; j < len; ++j) {
+                int tag = tags[j / 4] >> 2 * (j % 4) & 3;
+                need += tag == TAG_BASE ? 0 : tag == TAG_ONE ? sizeof(L) : tag == TAG_TWO ? 2 * sizeof(L) : sizeof(H);
+            }
+            if (have != need)
+                return false;
+        }
+        return true;
+    }
+
+    // @brief encode v[0..n) at the end of the stream; n must be a multiple of
+    // HFP_BLOCK unless this is the last call
+    void append(const H* v, unsigned long n) {
+        for (unsigned long off = 0; off < n; off += HFP_BLOCK)
+            encode_block(v + off, std::min(n - off, (unsigned long)HFP_BLOCK));
+    }
+
+    // @brief decode block kb into out[0..HFP_BLOCK), returns its length
+    unsigned long decode_block(unsigned long kb, H* out) const {
+        unsigned long len = block_size(kb);
+        const unsigned char* tags = &m_data[m_offset[kb]];
+        const unsigned char* p = tags + tag_bytes(len);
+        H r0 = 0, r1 = 0;
+
+        for (unsigned long j = 0; j < len; ++j) {
+            H base = predict(j, r0, r1);
+            int tag = tags[j / 4] >> 2 * (j % 4) & 3;
+            L t1, t2;
+            switch (tag) {
+                case TAG_BASE:
+                    out[j] = base;
+                    break;
+                case TAG_ONE:
+                    memcpy(&t1, p, sizeof(L)); p += sizeof(L);
+                    out[j] = base + (H)t1;
+                    break;
+                case TAG_TWO:
+                    memcpy(&t1, p, sizeof(L)); p += sizeof(L);
+                    memcpy(&t2, p, sizeof(L)); p += sizeof(L);
+                    out[j] = base + ((H)t1 + (H)t2);
+                    break;
+                default:
+                    memcpy(&out[j], p, sizeof(H)); p += sizeof(H);
+                    break;
+            }
+            r0 = r1;
+            r1 = out[j];
+        }
+        return len;
+    }
+
+    // @brief decode the whole stream into v[0..size())
+    void decode(H* v) const {
+        for (unsigned long kb = 0; kb < blocks(); ++kb)
+            decode_block(kb, v + kb * HFP_BLOCK);
+    }
+
+    // @brief the decoded value i, by decoding its block only
+    H get(unsigned long i) const {
+        H out[HFP_BLOCK];
+        decode_block(i / HFP_BLOCK, out);
+        return out[i % HFP_BLOCK];
+    }
+
+private:
+    static unsigned long tag_bytes(unsigned long len) { return (len + 3) / 4; }
+
+    unsigned long block_size(unsigned long kb) const {
+        return std::min(m_n - kb * HFP_BLOCK, (unsigned long)HFP_BLOCK);
+    }
+
+    // @brief base of element j of a block from the two decoded values before it
+    static H predict(unsigned long j, H r0, H r1) {
+        return j == 0 ? (H)0 : j == 1 ? r1 : r1 + (r1 - r0);
+    }
+
+    // @brief r decodes v: bitwise equal if lossless, so that -0 and NaN
+    // payloads survive, otherwise |v - r| <= tol (never for NaN)
+    bool close(H v, H r) const {
+        if (m_tol == 0)
+            return memcmp(&v, &r, sizeof(H)) == 0;
+        H d = v - r;
+        return (d < 0 ? -d : d) <= m_tol;
+    }
+
+    template <typename T>
+    void put(T x) {
+        unsigned long at = m_data.size();
+        m_data.resize(at + sizeof(T));
+        memcpy(&m_data[at], &x, sizeof(T));
+    }
+
+    void encode_block(const H* v, unsigned long len) {
+        unsigned long at = m_data.size();
+        H r0 = 0, r1 = 0;
+
+        m_data.resize(at + tag_bytes(len), 0);
+        for (unsigned long j = 0; j < len; ++j) {
+            H base = predict(j, r0, r1), res = v[j] - base, r;
+            L t1 = (L)res, t2 = (L)(res - (H)t1);
+            int tag;
+
+            if (close(v[j], base)) {
+                tag = TAG_BASE;
+                r = base;
+            } else if (close(v[j], base + (H)t1)) {
+                tag = TAG_ONE;
+                r = base + (H)t1;
+                put(t1);
+            } else if (close(v[j], base + ((H)t1 + (H)t2))) {
+                tag = TAG_TWO;
+                r = base + ((H)t1 + (H)t2);
+                put(t1);
+                put(t2);
+            } else {
+                tag = TAG_RAW;
+                r = v[j];
+                put(v[j]);
+            }
+            m_data[at + j / 4] |= tag << 2 * (j % 4);
+            m_count[tag]++;
+            r0 = r1;
+            r1 = r;
+        }
+        m_n += len;
+        m_offset.push_back(m_data.size());
+    }
+
+    unsigned long m_n;
+    H m_tol;
+    std::vector<unsigned char> m_data;
+    std::vector<uint64_t> m_offset;
+    unsigned long m_count[4];
+};
+
+#endif //EXPFLOAT_HIERARCHICAL_H
@@ -0,0 +1,211 @@
+//
+// Opt-in hardware performance counters through Linux perf_event_open.
+//
+// Set EXPFLOAT_PERF=1 in the environment to enable them. The counters are
+// opened once, for the calling thread only (OpenMP workers are not counted),
+// and left running; a PerfReading is a snapshot of all of them, so regions
+// can nest and be measured by subtracting two snapshots:
+//
+//     PerfReading r0 = perf_counters().read();
+//     kernel();
+//     std::cout << perf_counters().report(r0, perf_counters().read(), n);
+//
+// Every event is opened on its own, so events the CPU, the VM or
+// perf_event_paranoid do not allow are skipped and the rest still work. When
+// the kernel multiplexes, counts are scaled by time enabled / time running.
+// flops are the FP_ARITH_INST_RETIRED events of Intel cores, weighted by the
+// number of operations per instruction (an FMA instruction counts as 2 ops
+// per lane in hardware as well).
+//
+
+#ifndef EXPFLOAT_PERF_COUNTERS_H
+#define EXPFLOAT_PERF_COUNTERS_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#define PERF_MAX_EVENTS 16
+
+enum perf_counter {
+    PERF_CYCLES, PERF_INSTRUCTIONS, PERF_BRANCHES, PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_FLOPS, PERF_TASK_CLOCK, PERF_PAGE_FAULTS,
+    PERF_NUM_COUNTERS
+};
+
+struct PerfReading {
+    double v[PERF_NUM_COUNTERS];
+};
+
+class PerfCounters {
+public:
+    PerfCounters() : m_num(0) {
+        const char* env = getenv("EXPFLOAT_PERF");
+        if (!env || !*env || strcmp(env, "0") == 0)
+            return;
+#ifdef __linux__
+        int saved = errno;
+        open(PERF_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(PERF_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(PERF_BRANCHES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS);
+        open(PERF_BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        open(PERF_L1D_MISSES, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+             | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        open(PERF_LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        if (intel()) {
+            // FP_ARITH_INST_RETIRED (event 0xc7), umasks grouped by ops per instruction:
+            // scalar, 128-bit double, 128-bit float + 256-bit double,
+            // 256-bit float + 512-bit double, 512-bit float
+            const uint64_t umask[5] = {0x03, 0x04, 0x18, 0x60, 0x80};
+            const double weight[5] = {1, 2, 4, 8, 16};
+            for (int k = 0; k < 5; ++k)
+                open(PERF_FLOPS, PERF_TYPE_RAW, 0xc7 | umask[k] << 8, weight[k]);
+        }
+        open(PERF_TASK_CLOCK, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+        open(PERF_PAGE_FAULTS, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+        // events that are not available are not an error for the caller
+        errno = saved;
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int k = 0; k < m_num; ++k)
+            close(m_event[k].fd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator= (const PerfCounters&) = delete;
+
+    // @brief true if at least one counter could be opened
+    bool enabled() const { return m_num > 0; }
+
+    // @brief true if counter c is being counted
+    bool has(perf_counter c) const {
+        for (int k = 0; k < m_num; ++k)
+            if (m_event[k].counter == c)
+                return true;
+        return false;
+    }
+
+    // @brief snapshot of all counters, scaled for multiplexing
+    PerfReading read() const {
+        PerfReading r;
+        for (int c = 0; c < PERF_NUM_COUNTERS; ++c)
+            r.v[c] = 0.0;
+#ifdef __linux__
+        for (int k = 0; k < m_num; ++k) {
+            uint64_t buf[3];
+            if (::read(m_event[k].fd, buf, sizeof(buf)) != sizeof(buf))
+                continue;
+            double scale = buf[2] ? (double)buf[1] / buf[2] : 0.0;
+            r.v[m_event[k].counter] += m_event[k].weight * buf[0] * scale;
+        }
+#endif
+        return r;
+    }
+
+    // @brief "ipc 2.1, 3.5 insn/elem, ..." for the counters between r0 and r1,
+    // the hardware ones per element where items > 0; empty if counting is off
+    std::string report(const PerfReading& r0, const PerfReading& r1, double items = 0) const {
+        static const char* name[PERF_NUM_COUNTERS] = {
+            "cycles", "insn", "branches", "br-miss", "l1d-miss", "llc-miss", "flops", "task-ms", "faults"
+        };
+        std::string s;
+        char buf[64];
+        double d[PERF_NUM_COUNTERS];
+
+        if (!enabled())
+            return s;
+        for (int c = 0; c < PERF_NUM_COUNTERS; ++c)
+            d[c] = r1.v[c] - r0.v[c];
+        d[PERF_TASK_CLOCK] *= 1e-6;
+
+        if (has(PERF_CYCLES) && has(PERF_INSTRUCTIONS) && d[PERF_CYCLES] > 0) {
+            snprintf(buf, sizeof(buf), "ipc %.3g", d[PERF_INSTRUCTIONS] / d[PERF_CYCLES]);
+            s += buf;
+        }
+        if (has(PERF_BRANCHES) && has(PERF_BRANCH_MISSES) && d[PERF_BRANCHES] > 0) {
+            snprintf(buf, sizeof(buf), "%sbr-miss %.3g%%", s.empty() ? "" : ", ",
+                     100.0 * d[PERF_BRANCH_MISSES] / d[PERF_BRANCHES]);
+            s += buf;
+        }
+        for (int c = 0; c < PERF_NUM_COUNTERS; ++c) {
+            if (!has((perf_counter)c) || c == PERF_BRANCHES)
+                continue;
+            if (items > 0 && c < PERF_TASK_CLOCK)
+                snprintf(buf, sizeof(buf), "%s%.4g %s/elem", s.empty() ? "" : ", ", d[c] / items, name[c]);
+            else
+                snprintf(buf, sizeof(buf), "%s%.4g %s", s.empty() ? "" : ", ", d[c], name[c]);
+            s += buf;
+        }
+        return s;
+    }
+
+private:
+#ifdef __linux__
+    void open(perf_counter c, uint32_t type, uint64_t config, double weight = 1.0) {
+        if (m_num == PERF_MAX_EVENTS)
+            return;
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0)
+            return;
+        m_event[m_num].fd = fd;
+        m_event[m_num].counter = c;
+        m_event[m_num].weight = weight;
+        ++m_num;
+    }
+#endif
+
+    static bool intel() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int a, b, c, d;
+        if (!__get_cpuid(0, &a, &b, &c, &d))
+            return false;
+        return b == 0x756e6547 && d == 0x49656e69 && c == 0x6c65746e;   // "GenuineIntel"
+#else
+        return false;
+#endif
+    }
+
+    struct Event {
+        int fd;
+        perf_counter counter;
+        double weight;
+    };
+
+    Event m_event[PERF_MAX_EVENTS];
+    int m_num;
+};
+
+// @brief the process-wide counters, opened on first use
+inline PerfCounters& perf_counters() {
+    static PerfCounters pc;
+    return pc;
+}
+
+#endif //EXPFLOAT_PERF_COUNTERS_H
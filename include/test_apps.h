@@ -5,6 +5,12 @@
 #ifndef EXPFLOAT_TEST_APPS_H
 #define EXPFLOAT_TEST_APPS_H
 
+#include <vector>
+
+#include <expansion_math.h>
+#include <expansion_simd.h>
+#include <expansion_array.h>
+
 /* low storage 4th order 5 Stage RK scheme
    a and b are NOT the standard RK coefficients */
 const double _lsrk45a[5] = {
@@ -39,11 +45,11 @@ const double        _crk4c[4] = { 0., .5, .5, 1. };
 /*---------------------------------------------*/
 
 template<typename T, int r>
-void test_rk45(unsigned int n, T *qres, T *qrhs, T *q) {
+void test_rk45(unsigned int n, T *qres, T *qrhs, T *q, int steps = 10000) {
   T rk4a, rk4b, rk4c;
   T dt = 0.01;
 
-  for (int t = 0; t < 10000; ++t) {
+  for (int t = 0; t < steps; ++t) {
 
     // Low-storage 5-stage 4th-order RK
     for (int k = 0; k < 5; ++k) {
@@ -65,15 +71,13 @@ void test_rk45(unsigned int n, T *qres, T *qrhs, T *q) {
   }
 }
 
+// qtmp holds the low terms of qres, n*r floats owned by the caller
 template<int r>
-void test_rk45_exp(unsigned int n, float *qres, float *qrhs, float *q) {
+void test_rk45_exp(unsigned int n, float *qres, float *qrhs, float *q, float *qtmp, int steps = 10000) {
   float rk4a, rk4b;
   float dt = 0.01;
 
-  // @todo, move outside the function ...
-  float *qtmp = new float[n*r];
-
-  for (int t = 0; t < 10000; ++t) {
+  for (int t = 0; t < steps; ++t) {
 
     // Low-storage 5-stage 4th-order RK
     for (int k = 0; k < 5; ++k) {
@@ -93,8 +97,79 @@ void test_rk45_exp(unsigned int n, float *qres, float *qrhs, float *q) {
       }
     }
   }
+}
 
-  delete [] qtmp;
+/*---------------------------------------------*/
+
+// @brief one stage of the low-storage scheme over n values, in one pass:
+// qres = a*qres + dt*rhs, then q += b*qres, with q and qres two-term
+// expansions; built per ISA, LSRK45Exp calls it through exp_kernels()
+inline void
+lsrk_update(float *q1, float *q2, float *r1, float *r2, const float *rhs,
+            float a, float b, float dt, unsigned long n) {
+  unsigned long i = 0;
+  float p1, p2;
+#if EXP_SIMD_WIDTH > 1
+  vfloat va = v_set1(a), vb = v_set1(b), vdt = v_set1(dt);
+  vfloat Q1, Q2, R1, R2, P1, P2;
+  for (; i < n - n % EXP_SIMD_WIDTH; i += EXP_SIMD_WIDTH) {
+    R1 = v_load(r1 + i);
+    R2 = v_load(r2 + i);
+    v_scale_expansion(R1, R2, va);
+    v_grow_expansion(R1, R2, v_mul(vdt, v_load(rhs + i)));
+    v_store(r1 + i, R1);
+    v_store(r2 + i, R2);
+
+    P1 = R1; P2 = R2;
+    v_scale_expansion(P1, P2, vb);
+    Q1 = v_load(q1 + i);
+    Q2 = v_load(q2 + i);
+    v_expansion_sum(Q1, Q2, P1, P2);
+    v_store(q1 + i, Q1);
+    v_store(q2 + i, Q2);
+  }
+#endif
+  for (; i < n; ++i) {
+    daxpy(r1 + i, r2 + i, a, dt * rhs[i]);
+    p1 = r1[i]; p2 = r2[i];
+    scale_expansion(&p1, &p2, b);
+    quick_expansion_sum(q1[i], q2[i], p1, p2);
+  }
 }
 
+// @brief low storage 4th order 5 stage RK (the _lsrk45 coefficients) with the
+// solution, residual and all stage updates in two-term float expansions.
+//
+// All r fields share one layout, field j of unknown i at j*n + i, so a stage
+// is a single contiguous pass over q, qres and the right hand side. The
+// residual lives in a Workspace owned by the caller and reused across calls.
+template<int r>
+class LSRK45Exp {
+public:
+  struct Workspace {
+    explicit Workspace(unsigned long n) : qres(n * r), qrhs(n * r) { }
+    ExpansionArray<float, 2> qres;
+    std::vector<float> qrhs;
+  };
+
+  LSRK45Exp(unsigned long n, float dt) : m_n(n), m_dt(dt) { }
+
+  // @brief advance q by one step from time t; rhs(t, q, out) evaluates the
+  // right hand side at stage time t into out[j*n + i]
+  template <typename RHS>
+  void step(ExpansionArray<float, 2> &q, double t, RHS rhs, Workspace &ws) const {
+    for (int k = 0; k < 5; ++k) {
+      rhs(t + _lsrk45c[k] * m_dt, q, ws.qrhs.data());
+      exp_kernels().lsrk_update(q.top(), q.term(1), ws.qres.top(), ws.qres.term(1), ws.qrhs.data(),
+                                _lsrk45a[k], _lsrk45b[k], m_dt, m_n * r);
+    }
+  }
+
+  unsigned long size() const { return m_n; }
+
+private:
+  unsigned long m_n;
+  float m_dt;
+};
+
 #endif //EXPFLOAT_TEST_APPS_H
@@ -1,23 +1,124 @@
 //
 // Created by hari on 8/14/15.
 //
+// Timing. With an invariant TSC (constant rate, keeps running in deep C
+// states) timer_ticks() reads the time stamp counter behind an lfence, which
+// is far cheaper than serializing with cpuid and still keeps the read from
+// drifting ahead of earlier instructions; timer_ticks_end() uses rdtscp so the
+// timed code has retired before the read. The TSC rate is calibrated once
+// against steady_clock. Without an invariant TSC (or off x86) the ticks are
+// steady_clock nanoseconds and no cycle counts are reported.
+//
 
 #ifndef EXPFLOAT_UTILS_H
 #define EXPFLOAT_UTILS_H
 
 #include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define EXP_HAVE_TSC 1
+#endif
+
+// length of the calibration against steady_clock
+#define TIMER_CALIBRATION_MS 20
+
+// @brief true if the TSC runs at a constant rate and rdtscp is available
+inline bool tsc_invariant() {
+#ifdef EXP_HAVE_TSC
+    unsigned int a, b, c, d;
+    if (__get_cpuid(0x80000000, &a, &b, &c, &d) == 0 || a < 0x80000007)
+        return false;
+    __get_cpuid(0x80000001, &a, &b, &c, &d);
+    bool rdtscp = d >> 27 & 1;
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    return rdtscp && (d >> 8 & 1);
+#else
+    return false;
+#endif
+}
 
-inline uint64_t rdtsc() {
+inline uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef EXP_HAVE_TSC
+// @brief TSC read that does not start before earlier instructions completed
+inline uint64_t tsc_begin() {
     uint32_t lo, hi;
-    __asm__ __volatile__ (
-    "xorl %%eax, %%eax\n"
-            "cpuid\n"
-            "rdtsc\n"
-    : "=a" (lo), "=d" (hi)
-    :
-    : "%ebx", "%ecx");
+    __asm__ __volatile__ ("lfence\n\trdtsc\n\tlfence" : "=a" (lo), "=d" (hi) : : "memory");
+    return (uint64_t)hi << 32 | lo;
+}
+
+// @brief TSC read after everything before it has retired
+inline uint64_t tsc_end() {
+    uint32_t lo, hi, aux;
+    __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a" (lo), "=d" (hi), "=c" (aux) : : "memory");
     return (uint64_t)hi << 32 | lo;
 }
+#endif
 
+struct TimerInfo {
+    bool tsc;           // ticks are TSC (reference) cycles, else nanoseconds
+    double frequency;   // ticks per second
+};
+
+// @brief timer source and rate, calibrated on first use
+inline const TimerInfo& timer_info() {
+    static const TimerInfo info = [] {
+        TimerInfo t;
+        t.tsc = tsc_invariant();
+        t.frequency = 1e9;
+#ifdef EXP_HAVE_TSC
+        if (t.tsc) {
+            uint64_t s0 = steady_ns(), c0 = tsc_begin(), s1;
+            while ((s1 = steady_ns()) - s0 < TIMER_CALIBRATION_MS * 1000000ull)
+                ;
+            uint64_t c1 = tsc_end();
+            t.frequency = (double)(c1 - c0) / ((s1 - s0) * 1e-9);
+        }
+#endif
+        return t;
+    }();
+    return info;
+}
+
+// @brief timestamp at the start of a timed region
+inline uint64_t timer_ticks() {
+#ifdef EXP_HAVE_TSC
+    if (timer_info().tsc)
+        return tsc_begin();
+#endif
+    return steady_ns();
+}
+
+// @brief timestamp at the end of a timed region
+inline uint64_t timer_ticks_end() {
+#ifdef EXP_HAVE_TSC
+    if (timer_info().tsc)
+        return tsc_end();
+#endif
+    return steady_ns();
+}
+
+inline double timer_seconds(uint64_t ticks) {
+    return ticks / timer_info().frequency;
+}
+
+// @brief "<s>s (<ns> ns/elem, <c> cyc/elem)" for ticks spent on items elements;
+// the cycles are TSC reference cycles and left out without an invariant TSC
+inline std::string timer_report(uint64_t ticks, double items) {
+    char buf[96];
+    double s = timer_seconds(ticks);
+    if (timer_info().tsc)
+        snprintf(buf, sizeof(buf), "%.6gs (%.4g ns/elem, %.4g cyc/elem)", s, s / items * 1e9, ticks / items);
+    else
+        snprintf(buf, sizeof(buf), "%.6gs (%.4g ns/elem)", s, s / items * 1e9);
+    return buf;
+}
 
 #endif //EXPFLOAT_UTILS_H
@@ -0,0 +1,732 @@
+// Benchmark suite for the expansion kernels, one benchmark per kernel and type.
+//
+//   expfloat_bench [--format=text|json|csv] [--filter=substr] [--reps=N]
+//                  [--warmup=N] [--sizes=n1,n2,...] [--out=file]
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <quadmath.h>
+
+#include <bench.h>
+#include <expansion_math.h>
+#include <expansion_simd.h>
+#include <expansion.h>
+#include <expansion_parallel.h>
+#include <expansion_repro.h>
+#include <expansion_array.h>
+#include <test_apps.h>
+#include <expansion_elementary.h>
+#include <expansion_sum.h>
+#include <hierarchical.h>
+#include <datagen.h>
+#include <expansion_dispatch.h>
+
+#define RK_STEPS 10
+
+template <typename T>
+static std::vector<T> uniform(unsigned long n, unsigned int seed) {
+    std::vector<T> v(n);
+    gen_uniform(v.data(), n, seed);
+    return v;
+}
+
+// ---- sum ------------------------------------------------------------------
+
+template <typename T>
+static void bm_sum_naive(bench::State& s) {
+    std::vector<T> a = uniform<T>(s.n, 1);
+    T sum;
+    s.measure([&] {
+        sum = 0.0;
+        for (unsigned long i = 0; i < s.n; ++i)
+            sum = sum + a[i];
+        bench::keep(sum);
+    });
+}
+BENCHMARK("sum/naive", "float", bm_sum_naive<float>);
+BENCHMARK("sum/naive", "double", bm_sum_naive<double>);
+
+BENCHMARK("sum/grow_expansion", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1);
+    float e1, e2;
+    s.measure([&] {
+        e1 = e2 = 0.0;
+        for (unsigned long i = 0; i < s.n; ++i)
+            grow_expansion(e1, e2, a[i]);
+        bench::keep(e1);
+        bench::keep(e2);
+    });
+});
+
+BENCHMARK("sum/simd", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1);
+    float e1, e2;
+    s.measure([&] { exp_sum_simd(a.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+BENCHMARK("sum/lanes8", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1);
+    float e1, e2;
+    s.measure([&] { exp_sum_lanes<8>(a.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+BENCHMARK("sum/parallel", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1);
+    float e1, e2;
+    s.measure([&] { exp_sum_parallel(a.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+BENCHMARK("sum/repro", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1);
+    float e1, e2;
+    s.measure([&] { exp_sum_repro(a.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+BENCHMARK("sum/Expansion<double,2>", "exp", [](bench::State& s) {
+    std::vector<double> a = uniform<double>(s.n, 1);
+    Expansion<double, 2> e;
+    s.measure([&] {
+        e = 0.0;
+        for (unsigned long i = 0; i < s.n; ++i)
+            e += a[i];
+        bench::keep(e);
+    });
+});
+
+// ---- summation strategies: every one of sum_strategies() on each input ------
+//
+// sum_<input>/<strategy>, all of type float, so each input gets its fastest
+// strategy marked; main's summation stage adds the errors.
+
+static void bm_sum_strategy(bench::State& s, int input, sum_fn f) {
+    std::vector<float> a(s.n);
+    if (input == 0)
+        gen_uniform(a.data(), s.n, 1);
+    else if (input == 1)
+        gen_ill_conditioned(a.data(), s.n, 1, 1e8);
+    else
+        gen_cancellation(a.data(), s.n, 1, 1e6);
+    float e1, e2;
+    s.measure([&] { f(a.data(), s.n, e1, e2); bench::keep(e1); bench::keep(e2); });
+}
+
+static bool register_sum_strategies() {
+    using namespace std::placeholders;
+    const char* inputs[3] = {"sum_uniform/", "sum_ill/", "sum_cancel/"};
+    for (int in = 0; in < 3; ++in)
+        for (size_t k = 0; k < sum_strategies().size(); ++k)
+            bench::add(std::string(inputs[in]) + sum_strategies()[k].name, "float",
+                       std::bind(bm_sum_strategy, _1, in, sum_strategies()[k].sum));
+    return true;
+}
+static bool sum_strategies_registered = register_sum_strategies();
+
+// ---- dot ------------------------------------------------------------------
+
+template <typename T>
+static void bm_dot_naive(bench::State& s) {
+    std::vector<T> a = uniform<T>(s.n, 1), b = uniform<T>(s.n, 2);
+    T r;
+    s.measure([&] { r = dot(a.data(), b.data(), s.n); bench::keep(r); });
+}
+BENCHMARK("dot/naive", "float", bm_dot_naive<float>);
+BENCHMARK("dot/naive", "double", bm_dot_naive<double>);
+
+BENCHMARK("dot/exp_dot", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2);
+    float e1, e2;
+    s.measure([&] { exp_dot(a.data(), b.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+BENCHMARK("dot/simd", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2);
+    float e1, e2;
+    s.measure([&] { exp_dot_simd(a.data(), b.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+BENCHMARK("dot/lanes8", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2);
+    float e1, e2;
+    s.measure([&] { exp_dot_lanes<8>(a.data(), b.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+BENCHMARK("dot/parallel", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2);
+    float e1, e2;
+    s.measure([&] { exp_dot_parallel(a.data(), b.data(), s.n, e1, e2); bench::keep(e1); });
+});
+
+// ---- two_product / two_sum --------------------------------------------------
+
+BENCHMARK("two_product/scalar", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2), x(s.n), y(s.n);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            two_product(a[i], b[i], x[i], y[i]);
+        bench::keep(x[0]);
+    });
+});
+
+BENCHMARK("two_product/array", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2), x(s.n), y(s.n);
+    s.measure([&] { two_product_array(a.data(), b.data(), x.data(), y.data(), s.n); bench::keep(x[0]); });
+});
+
+BENCHMARK("two_sum/scalar", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2), x(s.n), y(s.n);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            two_sum(a[i], b[i], x[i], y[i]);
+        bench::keep(x[0]);
+    });
+});
+
+BENCHMARK("two_sum/array", "exp", [](bench::State& s) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2), x(s.n), y(s.n);
+    s.measure([&] { two_sum_array(a.data(), b.data(), x.data(), y.data(), s.n); bench::keep(x[0]); });
+});
+
+// ---- branchy vs branch-free error-free sums, per input pattern ------------
+//
+// sorted:      a and b sorted, so the magnitude order changes rarely
+// random:      independent uniform(-1, 1), the order is a coin flip
+// adversarial: b = -a (1 + tiny) over 40 binades, random order and heavy
+//              cancellation
+
+static const char* patterns[3] = {"sorted", "random", "adversarial"};
+
+static void pattern_data(int p, unsigned long n, std::vector<float>& a, std::vector<float>& b) {
+    std::mt19937 mt(7);
+    std::uniform_real_distribution<float> u(-1, 1);
+    a.resize(n);
+    b.resize(n);
+    for (unsigned long i = 0; i < n; ++i) {
+        a[i] = u(mt);
+        b[i] = u(mt);
+        if (p == 2) {
+            a[i] = ldexpf(a[i], (int)(mt() % 41) - 20);
+            b[i] = -a[i] * (1.0f + ldexpf(u(mt), -12));
+        }
+    }
+    if (p == 0) {
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+    }
+}
+
+// (e1, e2) and (f1, f2) expansions whose leading terms follow the pattern
+static void pattern_expansions(int p, unsigned long n, std::vector<float>& e1, std::vector<float>& e2,
+                               std::vector<float>& f1, std::vector<float>& f2) {
+    pattern_data(p, n, e1, f1);
+    e2.resize(n);
+    f2.resize(n);
+    for (unsigned long i = 0; i < n; ++i) {
+        e2[i] = ldexpf(e1[i], -30);
+        f2[i] = -ldexpf(f1[i], -31);
+    }
+}
+
+template <void (*F)(float, float, float&, float&)>
+static void bm_two_sum_pattern(bench::State& s, int p) {
+    std::vector<float> a, b, x(s.n), y(s.n);
+    pattern_data(p, s.n, a, b);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            F(a[i], b[i], x[i], y[i]);
+        bench::keep(x[0]);
+    });
+}
+
+template <void (*F)(const float*, const float*, float*, float*, unsigned long)>
+static void bm_two_sum_array_pattern(bench::State& s, int p) {
+    std::vector<float> a, b, x(s.n), y(s.n);
+    pattern_data(p, s.n, a, b);
+    s.measure([&] { F(a.data(), b.data(), x.data(), y.data(), s.n); bench::keep(x[0]); });
+}
+
+// every call restores (e1, e2) first, which costs the same for all variants
+template <void (*F)(float&, float&, float, float)>
+static void bm_expansion_sum_pattern(bench::State& s, int p) {
+    std::vector<float> e1, e2, f1, f2;
+    pattern_expansions(p, s.n, e1, e2, f1, f2);
+    std::vector<float> x1(s.n), x2(s.n);
+    s.measure([&] {
+        std::copy(e1.begin(), e1.end(), x1.begin());
+        std::copy(e2.begin(), e2.end(), x2.begin());
+        for (unsigned long i = 0; i < s.n; ++i)
+            F(x1[i], x2[i], f1[i], f2[i]);
+        bench::keep(x1[0]);
+    });
+}
+
+static void bm_expansion_sum_array_pattern(bench::State& s, int p) {
+    std::vector<float> e1, e2, f1, f2;
+    pattern_expansions(p, s.n, e1, e2, f1, f2);
+    std::vector<float> x1(s.n), x2(s.n);
+    s.measure([&] {
+        std::copy(e1.begin(), e1.end(), x1.begin());
+        std::copy(e2.begin(), e2.end(), x2.begin());
+        fast_expansion_sum_array(x1.data(), x2.data(), f1.data(), f2.data(), s.n);
+        bench::keep(x1[0]);
+    });
+}
+
+// the scalar forms as loops over arrays, so each is inlined into its own loop
+// and auto below pays one indirect call per array, not per element
+template <void (*F)(float, float, float&, float&)>
+static void two_sum_loop(const float* a, const float* b, float* x, float* y, unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i)
+        F(a[i], b[i], x[i], y[i]);
+}
+
+template <void (*F)(float&, float&, float, float)>
+static void expansion_sum_loop(float* e1, float* e2, const float* f1, const float* f2, unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i)
+        F(e1[i], e2[i], f1[i], f2[i]);
+}
+
+// auto: bench::pick chooses branch, select or two_sum on the first 4096
+// elements of the input (untimed), then the choice is timed like the others
+static void bm_two_sum_pattern_auto(bench::State& s, int p) {
+    typedef void (*loop_fn)(const float*, const float*, float*, float*, unsigned long);
+    static const loop_fn forms[3] = {two_sum_loop<fast_two_sum>, two_sum_loop<fast_two_sum_select>,
+                                     two_sum_loop<two_sum>};
+    std::vector<float> a, b, x(s.n), y(s.n);
+    pattern_data(p, s.n, a, b);
+    unsigned long m = std::min(s.n, 4096ul);
+    std::vector<std::function<void()> > candidates;
+    for (int k = 0; k < 3; ++k)
+        candidates.push_back([&, k] { forms[k](a.data(), b.data(), x.data(), y.data(), m); bench::keep(x[0]); });
+    loop_fn F = forms[bench::pick(candidates)];
+    s.measure([&] { F(a.data(), b.data(), x.data(), y.data(), s.n); bench::keep(x[0]); });
+}
+
+static void bm_expansion_sum_pattern_auto(bench::State& s, int p) {
+    typedef void (*loop_fn)(float*, float*, const float*, const float*, unsigned long);
+    static const loop_fn forms[3] = {expansion_sum_loop<fast_expansion_sum>,
+                                     expansion_sum_loop<fast_expansion_sum_select>, expansion_sum_loop<expansion_sum>};
+    std::vector<float> e1, e2, f1, f2;
+    pattern_expansions(p, s.n, e1, e2, f1, f2);
+    std::vector<float> x1(e1), x2(e2);
+    unsigned long m = std::min(s.n, 4096ul);
+    std::vector<std::function<void()> > candidates;
+    for (int k = 0; k < 3; ++k)
+        candidates.push_back([&, k] { forms[k](x1.data(), x2.data(), f1.data(), f2.data(), m); bench::keep(x1[0]); });
+    loop_fn F = forms[bench::pick(candidates)];
+    s.measure([&] {
+        std::copy(e1.begin(), e1.end(), x1.begin());
+        std::copy(e2.begin(), e2.end(), x2.begin());
+        F(x1.data(), x2.data(), f1.data(), f2.data(), s.n);
+        bench::keep(x1[0]);
+    });
+}
+
+static bool register_patterns() {
+    using namespace std::placeholders;
+    for (int p = 0; p < 3; ++p) {
+        std::string ts = std::string("fast_two_sum/") + patterns[p] + "/";
+        bench::add(ts + "branch", "exp", std::bind(bm_two_sum_pattern<fast_two_sum>, _1, p));
+        bench::add(ts + "select", "exp", std::bind(bm_two_sum_pattern<fast_two_sum_select>, _1, p));
+        bench::add(ts + "two_sum", "exp", std::bind(bm_two_sum_pattern<two_sum>, _1, p));
+        bench::add(ts + "select_array", "exp", std::bind(bm_two_sum_array_pattern<fast_two_sum_array>, _1, p));
+        bench::add(ts + "two_sum_array", "exp", std::bind(bm_two_sum_array_pattern<two_sum_array>, _1, p));
+        bench::add(ts + "auto", "exp", std::bind(bm_two_sum_pattern_auto, _1, p));
+
+        std::string es = std::string("fast_expansion_sum/") + patterns[p] + "/";
+        bench::add(es + "branch", "exp", std::bind(bm_expansion_sum_pattern<fast_expansion_sum>, _1, p));
+        bench::add(es + "select", "exp", std::bind(bm_expansion_sum_pattern<fast_expansion_sum_select>, _1, p));
+        bench::add(es + "two_sum", "exp", std::bind(bm_expansion_sum_pattern<expansion_sum>, _1, p));
+        bench::add(es + "select_array", "exp", std::bind(bm_expansion_sum_array_pattern, _1, p));
+        bench::add(es + "auto", "exp", std::bind(bm_expansion_sum_pattern_auto, _1, p));
+    }
+    return true;
+}
+static bool patterns_registered = register_patterns();
+
+// ---- daxpy ----------------------------------------------------------------
+
+template <typename T>
+static void bm_axpy_naive(bench::State& s) {
+    std::vector<T> x = uniform<T>(s.n, 1), b = uniform<T>(s.n, 2);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            x[i] = T(0.999) * x[i] + b[i];
+        bench::keep(x[0]);
+    });
+}
+BENCHMARK("daxpy/naive", "float", bm_axpy_naive<float>);
+BENCHMARK("daxpy/naive", "double", bm_axpy_naive<double>);
+
+BENCHMARK("daxpy/scalar", "exp", [](bench::State& s) {
+    std::vector<float> x1 = uniform<float>(s.n, 1), x2(s.n), b = uniform<float>(s.n, 2);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            daxpy(&x1[i], &x2[i], 0.999f, b[i]);
+        bench::keep(x1[0]);
+    });
+});
+
+BENCHMARK("daxpy/array", "exp", [](bench::State& s) {
+    ExpansionArray<float, 2> x(s.n);
+    std::vector<float> b = uniform<float>(s.n, 2);
+    s.measure([&] { x.daxpy(0.999f, b.data()); bench::keep(x.top()[0]); });
+});
+
+// ---- the same kernels for every ISA this CPU can run ------------------------
+
+static void bm_dispatch_sum(bench::State& s, const ExpKernels* k) {
+    std::vector<float> a = uniform<float>(s.n, 1);
+    float e1, e2;
+    s.measure([&] { k->exp_sum(a.data(), s.n, e1, e2); bench::keep(e1); });
+}
+
+static void bm_dispatch_dot(bench::State& s, const ExpKernels* k) {
+    std::vector<float> a = uniform<float>(s.n, 1), b = uniform<float>(s.n, 2);
+    float e1, e2;
+    s.measure([&] { k->exp_dot(a.data(), b.data(), s.n, e1, e2); bench::keep(e1); });
+}
+
+static void bm_dispatch_daxpy(bench::State& s, const ExpKernels* k) {
+    std::vector<float> x1 = uniform<float>(s.n, 1), x2(s.n), b = uniform<float>(s.n, 2);
+    s.measure([&] { k->daxpy_array(x1.data(), x2.data(), 0.999f, b.data(), s.n); bench::keep(x1[0]); });
+}
+
+static bool register_dispatch() {
+    using namespace std::placeholders;
+    for (int i = 0; i < EXP_NUM_ISAS; ++i) {
+        const ExpKernels* k = exp_kernels_for((exp_isa)i);
+        if (!k)
+            continue;
+        bench::add(std::string("dispatch/sum/") + k->name, "exp", std::bind(bm_dispatch_sum, _1, k));
+        bench::add(std::string("dispatch/dot/") + k->name, "exp", std::bind(bm_dispatch_dot, _1, k));
+        bench::add(std::string("dispatch/daxpy/") + k->name, "exp", std::bind(bm_dispatch_daxpy, _1, k));
+    }
+    return true;
+}
+static bool dispatch_registered = register_dispatch();
+
+// ---- polynomial evaluation, degree 8 (unrolled) and 24 (generic) -----------
+
+static void bm_horner_float(bench::State& s, int degree) {
+    std::vector<float> c = uniform<float>(degree + 1, 3), x = uniform<float>(s.n, 1), y(s.n);
+    s.measure([&] { exp_kernels().horner_array(c.data(), degree, x.data(), y.data(), s.n); bench::keep(y[0]); });
+}
+
+static void bm_horner_double(bench::State& s, int degree) {
+    std::vector<float> c = uniform<float>(degree + 1, 3), x = uniform<float>(s.n, 1);
+    std::vector<double> dc(c.begin(), c.end()), y(s.n);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            y[i] = horner(dc.data(), degree, (double)x[i]);
+        bench::keep(y[0]);
+    });
+}
+
+static void bm_horner_comp(bench::State& s, int degree, const ExpKernels* k) {
+    std::vector<float> c = uniform<float>(degree + 1, 3), x = uniform<float>(s.n, 1), r1(s.n), r2(s.n);
+    s.measure([&] { k->comp_horner_array(c.data(), degree, x.data(), r1.data(), r2.data(), s.n); bench::keep(r1[0]); });
+}
+
+static bool register_horner() {
+    using namespace std::placeholders;
+    const int degrees[2] = {8, 24};
+    for (int d = 0; d < 2; ++d) {
+        std::string name = "horner_" + std::to_string(degrees[d]);
+        bench::add(name, "float", std::bind(bm_horner_float, _1, degrees[d]));
+        bench::add(name, "double", std::bind(bm_horner_double, _1, degrees[d]));
+        bench::add(name, "exp", std::bind(bm_horner_comp, _1, degrees[d], &exp_kernels()));
+        for (int i = 0; i < EXP_NUM_ISAS; ++i) {
+            const ExpKernels* k = exp_kernels_for((exp_isa)i);
+            if (k)
+                bench::add("dispatch/" + name + "/" + k->name, "exp", std::bind(bm_horner_comp, _1, degrees[d], k));
+        }
+    }
+    return true;
+}
+static bool horner_registered = register_horner();
+
+// ---- Runge-Kutta (RK_STEPS steps of r = 1 fields, per element and stage) ---
+
+template <typename T>
+static void bm_rk45(bench::State& s) {
+    std::vector<T> qres = uniform<T>(s.n, 1), qrhs = uniform<T>(s.n, 2), q = uniform<T>(s.n, 3);
+    s.items = s.n * 5 * RK_STEPS;
+    s.measure([&] { test_rk45<T, 1>(s.n, qres.data(), qrhs.data(), q.data(), RK_STEPS); bench::keep(q[0]); });
+}
+BENCHMARK("rk45", "float", bm_rk45<float>);
+BENCHMARK("rk45", "double", bm_rk45<double>);
+
+BENCHMARK("rk45", "exp", [](bench::State& s) {
+    std::vector<float> qres = uniform<float>(s.n, 1), qrhs = uniform<float>(s.n, 2), q = uniform<float>(s.n, 3);
+    std::vector<float> qtmp(s.n);
+    s.items = s.n * 5 * RK_STEPS;
+    s.measure([&] {
+        test_rk45_exp<1>(s.n, qres.data(), qrhs.data(), q.data(), qtmp.data(), RK_STEPS);
+        bench::keep(q[0]);
+    });
+});
+
+BENCHMARK("rk45/fused", "exp", [](bench::State& s) {
+    std::vector<float> qrhs = uniform<float>(s.n, 2);
+    LSRK45Exp<1> rk(s.n, 0.01);
+    LSRK45Exp<1>::Workspace ws(s.n);
+    ExpansionArray<float, 2> q(s.n);
+    auto rhs = [&](double, const ExpansionArray<float, 2>&, float* out) {
+        std::copy(qrhs.begin(), qrhs.end(), out);
+    };
+    s.items = s.n * 5 * RK_STEPS;
+    s.measure([&] {
+        for (int t = 0; t < RK_STEPS; ++t)
+            rk.step(q, t * 0.01, rhs, ws);
+        bench::keep(q.top()[0]);
+    });
+});
+
+// ---- double-double and quad-double against libquadmath's __float128 -------
+//
+// family wide_<op>, one variant per representation, so the text table marks
+// the fastest of dd, qd and quad
+
+static void from_quad(__float128 v, __float128& r) { r = v; }
+template <int N>
+static void from_quad(__float128 v, Expansion<double, N>& r) { r = to_expansion<double, N>(v); }
+
+// @brief uniform values with a full-width low part
+template <typename E>
+static std::vector<E> uniform_wide(unsigned long n, unsigned int seed) {
+    std::vector<double> hi = uniform<double>(n, seed), lo = uniform<double>(n, seed + 100);
+    std::vector<E> v(n);
+    for (unsigned long i = 0; i < n; ++i)
+        from_quad((__float128)hi[i] + (__float128)lo[i] * ldexp(1.0, -53), v[i]);
+    return v;
+}
+
+template <typename E>
+static void bm_wide_add(bench::State& s) {
+    std::vector<E> a = uniform_wide<E>(s.n, 1), b = uniform_wide<E>(s.n, 2), c(s.n);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            c[i] = a[i] + b[i];
+        bench::keep(c[0]);
+    });
+}
+BENCHMARK("wide_add/dd", "wide", bm_wide_add<DoubleDouble>);
+BENCHMARK("wide_add/qd", "wide", bm_wide_add<QuadDouble>);
+BENCHMARK("wide_add/quad", "wide", bm_wide_add<__float128>);
+
+template <typename E>
+static void bm_wide_mul(bench::State& s) {
+    std::vector<E> a = uniform_wide<E>(s.n, 1), b = uniform_wide<E>(s.n, 2), c(s.n);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            c[i] = a[i] * b[i];
+        bench::keep(c[0]);
+    });
+}
+BENCHMARK("wide_mul/dd", "wide", bm_wide_mul<DoubleDouble>);
+BENCHMARK("wide_mul/qd", "wide", bm_wide_mul<QuadDouble>);
+BENCHMARK("wide_mul/quad", "wide", bm_wide_mul<__float128>);
+
+// @brief dot product of double inputs accumulated in E
+template <typename E>
+static void bm_wide_dot(bench::State& s) {
+    std::vector<double> a = uniform<double>(s.n, 1), b = uniform<double>(s.n, 2);
+    E r;
+    s.measure([&] {
+        r = E(0.0);
+        for (unsigned long i = 0; i < s.n; ++i)
+            r += E(a[i]) * b[i];
+        bench::keep(r);
+    });
+}
+BENCHMARK("wide_dot/dd", "wide", bm_wide_dot<DoubleDouble>);
+BENCHMARK("wide_dot/qd", "wide", bm_wide_dot<QuadDouble>);
+BENCHMARK("wide_dot/quad", "wide", bm_wide_dot<__float128>);
+
+static __float128 wide_sqrt(__float128 v) { return sqrtq(v); }
+template <int N>
+static Expansion<double, N> wide_sqrt(const Expansion<double, N>& v) { return sqrt(v); }
+
+template <typename E>
+static void bm_wide_div(bench::State& s) {
+    std::vector<E> a = uniform_wide<E>(s.n, 1), b = uniform_wide<E>(s.n, 2), c(s.n);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            c[i] = a[i] / b[i];
+        bench::keep(c[0]);
+    });
+}
+BENCHMARK("wide_div/dd", "wide", bm_wide_div<DoubleDouble>);
+BENCHMARK("wide_div/qd", "wide", bm_wide_div<QuadDouble>);
+BENCHMARK("wide_div/quad", "wide", bm_wide_div<__float128>);
+
+template <typename E>
+static void bm_wide_sqrt(bench::State& s) {
+    std::vector<E> a = uniform_wide<E>(s.n, 1), c(s.n);
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            c[i] = wide_sqrt(a[i]);
+        bench::keep(c[0]);
+    });
+}
+BENCHMARK("wide_sqrt/dd", "wide", bm_wide_sqrt<DoubleDouble>);
+BENCHMARK("wide_sqrt/qd", "wide", bm_wide_sqrt<QuadDouble>);
+BENCHMARK("wide_sqrt/quad", "wide", bm_wide_sqrt<__float128>);
+
+// the batched versions, in place on structure-of-arrays storage; repeated
+// calls divide by [1, 2) and take roots of roots, so the values stay finite
+template <int N>
+static void wide_array(ExpansionArray<double, N>& x, unsigned long n, unsigned int seed, double shift) {
+    std::vector<Expansion<double, N> > v = uniform_wide<Expansion<double, N> >(n, seed);
+    for (unsigned long i = 0; i < n; ++i)
+        x.set(i, v[i] + shift);
+}
+
+BENCHMARK("wide_div/dd_array", "wide", [](bench::State& s) {
+    ExpansionArray<double, 2> a(s.n), b(s.n);
+    wide_array(a, s.n, 1, 0.0);
+    wide_array(b, s.n, 2, 1.0);
+    s.measure([&] { a.div(b); bench::keep(a.top()[0]); });
+});
+
+BENCHMARK("wide_sqrt/dd_array", "wide", [](bench::State& s) {
+    ExpansionArray<double, 2> a(s.n);
+    wide_array(a, s.n, 1, 0.0);
+    s.measure([&] { a.sqrt(); bench::keep(a.top()[0]); });
+});
+
+// elementary functions, arguments in shift + scale [0, 1)
+#define WIDE_FUNCTION(name, quad)                                                                       \
+    static __float128 wide_##name(const __float128& v) { return quad(v); }                              \
+    template <int N>                                                                                    \
+    static Expansion<double, N> wide_##name(const Expansion<double, N>& v) { return name(v); }          \
+    template <int N>                                                                                    \
+    static void wide_##name##_array(const ExpansionArray<double, N>& a, ExpansionArray<double, N>& r) { \
+        name##_array(a, r);                                                                             \
+    }
+WIDE_FUNCTION(exp, expq)
+WIDE_FUNCTION(log, logq)
+WIDE_FUNCTION(sin, sinq)
+WIDE_FUNCTION(cos, cosq)
+#undef WIDE_FUNCTION
+
+template <typename E, E (*F)(const E&)>
+static void bm_wide_function(bench::State& s, double scale, double shift) {
+    std::vector<E> a = uniform_wide<E>(s.n, 1), c(s.n);
+    for (unsigned long i = 0; i < s.n; ++i)
+        a[i] = a[i] * scale + shift;
+    s.measure([&] {
+        for (unsigned long i = 0; i < s.n; ++i)
+            c[i] = F(a[i]);
+        bench::keep(c[0]);
+    });
+}
+
+template <void (*F)(const ExpansionArray<double, 2>&, ExpansionArray<double, 2>&)>
+static void bm_wide_function_array(bench::State& s, double scale, double shift) {
+    ExpansionArray<double, 2> a(s.n), c(s.n);
+    wide_array(a, s.n, 1, 0.0);
+    for (unsigned long i = 0; i < s.n; ++i)
+        a.set(i, a.get(i) * scale + shift);
+    s.measure([&] { F(a, c); bench::keep(c.top()[0]); });
+}
+
+typedef void (*WideFunctionBench)(bench::State&, double, double);
+
+static void add_wide_function(const std::string& name, double scale, double shift, WideFunctionBench dd,
+                              WideFunctionBench qd, WideFunctionBench quad, WideFunctionBench dd_array) {
+    using namespace std::placeholders;
+    bench::add("wide_" + name + "/dd", "wide", std::bind(dd, _1, scale, shift));
+    bench::add("wide_" + name + "/qd", "wide", std::bind(qd, _1, scale, shift));
+    bench::add("wide_" + name + "/quad", "wide", std::bind(quad, _1, scale, shift));
+    bench::add("wide_" + name + "/dd_array", "wide", std::bind(dd_array, _1, scale, shift));
+}
+
+static bool register_elementary() {
+    add_wide_function("exp", 20, -10, bm_wide_function<DoubleDouble, wide_exp>, bm_wide_function<QuadDouble, wide_exp>,
+                      bm_wide_function<__float128, wide_exp>, bm_wide_function_array<wide_exp_array>);
+    add_wide_function("log", 100, 0, bm_wide_function<DoubleDouble, wide_log>, bm_wide_function<QuadDouble, wide_log>,
+                      bm_wide_function<__float128, wide_log>, bm_wide_function_array<wide_log_array>);
+    add_wide_function("sin", 200, -100, bm_wide_function<DoubleDouble, wide_sin>, bm_wide_function<QuadDouble, wide_sin>,
+                      bm_wide_function<__float128, wide_sin>, bm_wide_function_array<wide_sin_array>);
+    add_wide_function("cos", 200, -100, bm_wide_function<DoubleDouble, wide_cos>, bm_wide_function<QuadDouble, wide_cos>,
+                      bm_wide_function<__float128, wide_cos>, bm_wide_function_array<wide_cos_array>);
+    return true;
+}
+static bool elementary_registered = register_elementary();
+
+// ---- hierarchical floating point -------------------------------------------
+
+BENCHMARK("hfp/count", "quad", [](bench::State& s) {
+    std::vector<__float128> v(s.n);
+    gen_sine(v.data(), 0, s.n, s.n);
+    unsigned long cnt;
+    s.measure([&] { cnt = hfp_count(v.data(), s.n); bench::keep(cnt); });
+});
+
+BENCHMARK("hfp/count", "double", [](bench::State& s) {
+    std::vector<double> v(s.n);
+    gen_sine(v.data(), 0, s.n, s.n);
+    unsigned long cnt;
+    s.measure([&] { cnt = hfp_count(v.data(), s.n); bench::keep(cnt); });
+});
+
+// HfpCodec on the sine of hfp/count, lossless and to a tolerance; bytes per
+// second count the raw values, encoded or decoded
+
+template <typename H>
+static void bm_hfp_encode(bench::State& s, H tol) {
+    std::vector<H> v(s.n);
+    gen_sine(v.data(), 0, s.n, s.n);
+    HfpCodec<H> codec(tol);
+    s.bytes = s.n * sizeof(H);
+    s.measure([&] { codec.encode(v.data(), s.n); bench::keep(codec); });
+}
+
+template <typename H>
+static void bm_hfp_decode(bench::State& s, H tol) {
+    std::vector<H> v(s.n), r(s.n);
+    gen_sine(v.data(), 0, s.n, s.n);
+    HfpCodec<H> codec(tol);
+    codec.encode(v.data(), s.n);
+    s.bytes = s.n * sizeof(H);
+    s.measure([&] { codec.decode(r.data()); bench::keep(r[0]); });
+}
+
+static bool register_hfp() {
+    using namespace std::placeholders;
+    bench::add("hfp/encode/lossless", "quad", std::bind(bm_hfp_encode<__float128>, _1, (__float128)0));
+    bench::add("hfp/encode/lossy", "quad", std::bind(bm_hfp_encode<__float128>, _1, (__float128)1e-24));
+    bench::add("hfp/encode/lossless", "double", std::bind(bm_hfp_encode<double>, _1, 0.0));
+    bench::add("hfp/encode/lossy", "double", std::bind(bm_hfp_encode<double>, _1, 1e-12));
+    bench::add("hfp/decode/lossless", "quad", std::bind(bm_hfp_decode<__float128>, _1, (__float128)0));
+    bench::add("hfp/decode/lossy", "quad", std::bind(bm_hfp_decode<__float128>, _1, (__float128)1e-24));
+    bench::add("hfp/decode/lossless", "double", std::bind(bm_hfp_decode<double>, _1, 0.0));
+    bench::add("hfp/decode/lossy", "double", std::bind(bm_hfp_decode<double>, _1, 1e-12));
+    return true;
+}
+static bool hfp_registered = register_hfp();
+
+// ---- test data generation ---------------------------------------------------
+
+BENCHMARK("gen_uniform", "double", [](bench::State& s) {
+    std::vector<double> v(s.n);
+    s.measure([&] { gen_uniform(v.data(), s.n, 1); bench::keep(v[0]); });
+});
+
+BENCHMARK("gen_sine", "quad", [](bench::State& s) {
+    std::vector<__float128> v(s.n);
+    s.measure([&] { gen_sine(v.data(), 0, s.n, s.n); bench::keep(v[1]); });
+});
+
+BENCHMARK("gen_sine", "double", [](bench::State& s) {
+    std::vector<double> v(s.n);
+    s.measure([&] { gen_sine(v.data(), 0, s.n, s.n); bench::keep(v[1]); });
+});
+
+int main(int argc, char* argv[]) {
+    return bench::run(argc, argv);
+}
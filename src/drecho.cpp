@@ -19,14 +19,21 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
 
+#include <perf_counters.h>
+
 #ifdef _WIN32
 #   include <windows.h>
 #   include <io.h>
@@ -172,19 +179,22 @@ namespace dr
             }
 
             void log( const std::string &line ) {
-                if( !line.size() )
-                    return;
-
-                std::deque<std::string> lines = split( line, '\n' );
-
-                for( set::iterator jt = cb.begin(), jend = cb.end(); jt != jend; ++jt )
-                    for( std::deque<std::string>::iterator it = lines.begin(), end = lines.end(); it != end; ++it )
-                    {
-                        if( *it != "\n" )
-                            (**jt)( false, false, false, *it );
-                        else
-                            (**jt)( false, true, false, std::string() );
+                // hand out the pieces between newlines and a feed for every
+                // newline, without copying when there is nothing to split
+                for( size_t at = 0; at < line.size(); ) {
+                    size_t nl = line.find( '\n', at );
+                    if( nl != at ) {
+                        bool whole = ( at == 0 && nl == std::string::npos );
+                        std::string piece = whole ? std::string() : line.substr( at, nl - at );
+                        for( set::iterator jt = cb.begin(), jend = cb.end(); jt != jend; ++jt )
+                            (**jt)( false, false, false, whole ? line : piece );
                     }
+                    if( nl == std::string::npos )
+                        break;
+                    for( set::iterator jt = cb.begin(), jend = cb.end(); jt != jend; ++jt )
+                        (**jt)( false, true, false, std::string() );
+                    at = nl + 1;
+                }
             }
 
             virtual int_type overflow( int_type c = traits_type::eof() ) {
@@ -351,29 +361,42 @@ namespace dr
 
 namespace dr {
 
+    // per thread, as scopes open and close on the thread that logs in them
     std::string &file() {
-        static std::string st;
+        static thread_local std::string st;
         return st;
     }
-    std::string &prefix() {
-        static std::string st;
+    int &depth() {
+        static thread_local int st = 0;
         return st;
     }
     std::string &spent() {
-        static std::string st;
+        static thread_local std::string st;
         return st;
     }
     unsigned &color() {
         static unsigned st = 0;
         return st;
     }
+    // counter snapshots of the open scopes, innermost last
+    std::vector<PerfReading> &counters() {
+        static thread_local std::vector<PerfReading> st;
+        return st;
+    }
 
     scope::scope() : clock(dr::clock()) {
-        prefix().push_back(' ');
+        depth()++;
+        if( perf_counters().enabled() ) {
+            counters().push_back( perf_counters().read() );
+        }
     }
     scope::~scope() {
         spent() = std::string("scoped for ") + to_string( dr::clock() - clock ) + "s";
-        prefix().pop_back();
+        if( perf_counters().enabled() ) {
+            spent() += " [" + perf_counters().report( counters().back(), perf_counters().read() ) + "]";
+            counters().pop_back();
+        }
+        depth()--;
     }
 }
 
@@ -437,11 +460,16 @@ namespace dr {
     }
 
     void logger( bool open, bool feed, bool close, const std::string &line );
+    class backend;
+    backend &writer();
+    std::atomic<bool> &async_on();
 
     bool capture( std::ostream &os_ ) {
         std::ostream *os = &os_;
         if( os != &dr::echo ) {
             if( dr::captured.find(os) == dr::captured.end() ) {
+                // start the writer now rather than on the first line
+                if( async_on() ) writer();
                 dr::captured.insert(os);
                 apathy::ostream::attach( *os, dr::logger );
                 return true;
@@ -454,6 +482,7 @@ namespace dr {
         std::ostream *os = &os_;
         if( os != &dr::echo ) {
             if( dr::captured.find(os) != dr::captured.end() ) {
+                dr::flush();
                 dr::captured.erase(os);
                 apathy::ostream::detach( *os );
                 return true;
@@ -501,85 +530,252 @@ namespace dr {
         return std::string();
     }
 
-    void logger( bool open, bool feed, bool close, const std::string &line )
-    {
-        static std::string cache;
+    // one finished line, with everything the writer needs from the thread that logged it
+    struct record {
+        double time;
+        int level;
+        std::string text, error, location, spent;
+    };
 
-        if( open )
-        {}
-        else
-        if( close )
-        {}
-        else
-        if( feed )
-        {
-            if( cache.empty() )
-                return;
+    // @brief write a record with colors and branches; only ever called by one
+    // thread at a time (the background writer, or under the sync mutex)
+    void write( record &r )
+    {
+        static size_t num_errors = 0;
+        // num lines to display in red
+        if( !r.error.empty() ) num_errors += 1; //5
 
-            static size_t num_errors = 0;
-            std::string err = dr::get_any_error();
-            // num lines to display in red
-            if( !err.empty() ) num_errors += 1; //5
+        if( dr::log_timestamp ) {
+            dr::printf( DR_WHITE_ALT, DR_CLOCKs " ", r.time );
+        }
 
-            if( dr::log_timestamp ) {
-                dr::printf( DR_WHITE_ALT, DR_CLOCKs " ", DR_CLOCK );
+        static int prevlvl = 0;
+        int lvl = r.level, last = lvl - 1;
+        bool pushes = (lvl > prevlvl), pops = (lvl < prevlvl);
+        if( dr::log_branch ) {
+            dr::printf( DR_GRAY, "|" );
+            for( int i = 0; i < lvl; i ++ ) {
+                int color = ( DR_GRAY + 1 + i ) % DR_TOTAL_COLORS;
+                /**/ if( pops ) {
+                    dr::printf( color, i==last ? "/" : "|" );
+                }
+                else if( pushes ) {
+                    dr::printf( color, i==last ? "\\" : "|" );
+                }
+                else {
+                    dr::printf( color, i==last ? "|" : "|" );
+                }
             }
+            prevlvl = lvl;
+            dr::printf( DR_DEFAULT, " " );
+        }
 
-            std::string prefix = dr::prefix();
-            static int prevlvl = 0;
-            int lvl = prefix.size(), last = lvl - 1;
-            bool pushes = (lvl > prevlvl), pops = (lvl < prevlvl), same = (lvl == prevlvl);
-            if( dr::log_branch ) {
-                dr::printf( DR_GRAY, "|" );
-                for( int i = 0; i < prefix.size(); i ++ ) {
-                    int color = ( DR_GRAY + 1 + i ) % DR_TOTAL_COLORS;
-                    /**/ if( lvl < prevlvl ) {
-                        dr::printf( color, i==last ? "/" : "|" );
-                    }
-                    else if( lvl > prevlvl ) {
-                        dr::printf( color, i==last ? "\\" : "|" );
-                    }
-                    else {
-                        dr::printf( color, i==last ? "|" : "|" );
-                    }
-                }
-                prevlvl = lvl;
-                dr::printf( DR_DEFAULT, " " );
+        if( dr::log_text ) {
+            std::vector<std::string> tags = split(lowercase(r.text), "!\"#~$%&/(){}[]|,;.:<>+-/*@'\"\t\n\\ ");
+            for( auto &tag : tags ) {
+                auto find = dr::vhighlights.find(tag);
+                int color = ( find == dr::vhighlights.end() ? DR_DEFAULT : find->second );
+                dr::print( color, tag );
             }
+        }
 
-            if( dr::log_text ) {
-                std::vector<std::string> tags = split(lowercase(cache), "!\"#~$%&/(){}[]|,;.:<>+-/*@'\"\t\n\\ ");
-                for( auto &tag : tags ) {
-                    auto find = dr::vhighlights.find(tag);
-                    int color = ( find == dr::vhighlights.end() ? DR_DEFAULT : find->second );
-                    dr::print( color, tag );
-                }
+        if( dr::log_errno ) {
+            dr::printf( num_errors ? DR_RED : DR_DEFAULT, " %s", r.error.c_str() );
+        }
+
+        if( dr::log_location ) {
+            if( r.location.size() ) {
+                dr::printf( DR_GRAY, " %s", r.location.c_str() );
             }
+        }
 
-            if( dr::log_errno ) {
-                dr::printf( num_errors ? DR_RED : DR_DEFAULT, " %s", err.c_str() );
+        if( dr::log_branch_scope ) {
+            if( pops && r.spent.size() ) {
+                dr::printf( DR_MAGENTA, " %s", r.spent.c_str() );
             }
+        }
 
-            if( dr::log_location ) {
-                if( dr::file().size() ) {
-                    dr::printf( DR_GRAY, " %s", dr::file().c_str() );
-                    dr::file() = std::string();
+        num_errors = 0;
+
+        fputs( "\n", stdout );
+    }
+
+    // bounded lock-free multi-producer single-consumer queue of records
+    // (Vyukov): every slot carries a sequence number that tells producers
+    // and the consumer whose turn it is, so pushing is one CAS on the head.
+    class ring {
+    public:
+        enum { SIZE = 4096 };
+
+        ring() : head(0), tail(0) {
+            for( size_t i = 0; i < SIZE; ++i ) slots[i].seq.store( i, std::memory_order_relaxed );
+        }
+
+        // @brief fill( record & ) the next free slot in place, so its strings
+        // keep their capacity from one lap to the next and nothing is allocated
+        // once the ring has warmed up; false if the ring is full
+        template<typename F>
+        bool try_push( F fill ) {
+            size_t pos = head.load( std::memory_order_relaxed );
+            for( ;; ) {
+                slot &sl = slots[ pos % SIZE ];
+                intptr_t dif = (intptr_t)sl.seq.load( std::memory_order_acquire ) - (intptr_t)pos;
+                if( dif == 0 ) {
+                    if( head.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) break;
                 }
+                else if( dif < 0 ) return false; // full
+                else pos = head.load( std::memory_order_relaxed );
             }
+            slot &sl = slots[ pos % SIZE ];
+            fill( sl.rec );
+            sl.seq.store( pos + 1, std::memory_order_release );
+            return true;
+        }
+
+        // @brief use( record & ) the oldest record in place; consumer only
+        template<typename F>
+        bool try_pop( F use ) {
+            slot &sl = slots[ tail % SIZE ];
+            if( (intptr_t)sl.seq.load( std::memory_order_acquire ) - (intptr_t)(tail + 1) < 0 ) return false;
+            use( sl.rec );
+            sl.seq.store( tail + SIZE, std::memory_order_release );
+            ++tail;
+            return true;
+        }
+
+    private:
+        struct slot {
+            std::atomic<size_t> seq;
+            record rec;
+        };
+        slot slots[SIZE];
+        std::atomic<size_t> head;
+        size_t tail;
+    };
+
+    // the background writer: drains the ring, sleeping when it is empty (for
+    // longer the longer it stays empty) rather than being woken, so logging
+    // never makes a system call
+    class backend {
+    public:
+        backend() : pushed(0), written(0), stop(false), worker( &backend::run, this ) {}
+
+        ~backend() {
+            stop = true;
+            worker.join();
+        }
+
+        template<typename F>
+        void push( F fill ) {
+            while( !queue.try_push( fill ) ) std::this_thread::yield();
+            pushed.fetch_add( 1, std::memory_order_release );
+        }
+
+        // @brief wait until everything pushed so far is written
+        void flush() {
+            size_t target = pushed.load( std::memory_order_acquire );
+            while( written.load( std::memory_order_acquire ) < target ) std::this_thread::yield();
+            fflush( stdout );
+        }
 
-            if( dr::log_branch_scope ) {
-                if( pops ) {
-                    dr::printf( DR_MAGENTA, " %s", spent().c_str() );
-                    spent() = std::string();
+    private:
+        void run() {
+            int idle = 1;
+            for( ;; ) {
+                bool any = false;
+                while( queue.try_pop( write ) ) {
+                    written.fetch_add( 1, std::memory_order_release );
+                    any = true;
+                }
+                if( any ) {
+                    fflush( stdout );
+                    idle = 1;
+                }
+                else if( stop ) break;
+                else {
+                    std::this_thread::sleep_for( std::chrono::milliseconds( idle ) );
+                    idle = std::min( 2 * idle, 16 );
                 }
             }
+        }
 
-            num_errors = 0;
-            dr::clear_errors();
+        ring queue;
+        std::atomic<size_t> pushed, written;
+        std::atomic<bool> stop;
+        std::thread worker;
+    };
 
-            fputs( "\n", stdout );
+    backend &writer() {
+        static backend st;
+        return st;
+    }
 
-            cache = std::string();
+    std::atomic<bool> &async_on() {
+        static std::atomic<bool> st( !getenv("DRECHO_SYNC") || !strcmp(getenv("DRECHO_SYNC"), "0") );
+        return st;
+    }
+
+    std::mutex &sync_mutex() {
+        static std::mutex st;
+        return st;
+    }
+
+    bool async( bool on ) {
+        flush();
+        return async_on().exchange( on );
+    }
+
+    void flush() {
+        if( async_on() ) writer().flush();
+        else fflush( stdout );
+    }
+
+    void logger( bool open, bool feed, bool close, const std::string &line )
+    {
+        static thread_local std::string cache;
+        // depth of this thread's previous line, to tell the pops that
+        // carry the time spent in the scope just closed
+        static thread_local int prevlvl = 0;
+
+        if( open )
+        {}
+        else
+        if( close )
+        {}
+        else
+        if( feed )
+        {
+            if( cache.empty() )
+                return;
+
+            // all that depends on the logging thread is taken here, the
+            // formatting is left to write()
+            double time = DR_CLOCK;
+            bool error = errno $win(|| GetLastError());
+            int level = dr::depth();
+            bool pops = level < prevlvl;
+            prevlvl = level;
+            auto fill = [&]( record &r ) {
+                r.time = time;
+                r.level = level;
+                r.text.assign( cache );
+                if( error ) r.error.assign( dr::get_any_error() ); else r.error.clear();
+                r.location.assign( dr::file() );
+                r.spent.assign( dr::spent() );
+            };
+
+            if( async_on() ) {
+                writer().push( fill );
+            } else {
+                static record r;
+                std::lock_guard<std::mutex> lock( sync_mutex() );
+                fill( r );
+                write( r );
+            }
+            cache.clear();
+            dr::file().clear();
+            if( pops ) dr::spent().clear();
+            dr::clear_errors();
         }
         else
         {
@@ -0,0 +1,222 @@
+// Selection of the per-ISA kernel tables built from expansion_isa.cpp, and
+// their correctness check against the scalar build.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <quadmath.h>
+
+#include <expansion_dispatch.h>
+
+extern const ExpKernels exp_kernels_0;
+#ifndef EXP_DISPATCH_SCALAR_ONLY
+extern const ExpKernels exp_kernels_1, exp_kernels_2, exp_kernels_3, exp_kernels_4;
+#endif
+
+// @brief true if the CPU (and OS) can run code built for isa
+static bool cpu_supports(exp_isa isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    switch (isa) {
+        case EXP_ISA_SCALAR:  return true;
+        case EXP_ISA_SSE41:   return __builtin_cpu_supports("sse4.1");
+        case EXP_ISA_AVX2:    return __builtin_cpu_supports("avx2");
+        case EXP_ISA_AVX2FMA: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case EXP_ISA_AVX512:  return __builtin_cpu_supports("avx512f");
+        default:              return false;
+    }
+#else
+    return isa == EXP_ISA_SCALAR;
+#endif
+}
+
+const ExpKernels* exp_kernels_for(exp_isa isa) {
+    static const ExpKernels* const tables[EXP_NUM_ISAS] = {
+#ifdef EXP_DISPATCH_SCALAR_ONLY
+        &exp_kernels_0, NULL, NULL, NULL, NULL
+#else
+        &exp_kernels_0, &exp_kernels_1, &exp_kernels_2, &exp_kernels_3, &exp_kernels_4
+#endif
+    };
+    if (isa < 0 || isa >= EXP_NUM_ISAS || !tables[isa] || !cpu_supports(isa))
+        return NULL;
+    return tables[isa];
+}
+
+static const ExpKernels* select_kernels() {
+    const ExpKernels* best = NULL;
+    for (int k = EXP_NUM_ISAS - 1; k >= 0 && !best; --k)
+        best = exp_kernels_for((exp_isa)k);
+
+    const char* env = getenv("EXPFLOAT_ISA");
+    if (!env || !*env)
+        return best;
+    for (int k = 0; k < EXP_NUM_ISAS; ++k) {
+        const ExpKernels* t = exp_kernels_for((exp_isa)k);
+        if (t && strcmp(env, t->name) == 0)
+            return t;
+    }
+    fprintf(stderr, "warning: EXPFLOAT_ISA=%s is not available on this CPU, using %s\n", env, best->name);
+    return best;
+}
+
+const ExpKernels& exp_kernels() {
+    static const ExpKernels* k = select_kernels();
+    return *k;
+}
+
+// @brief bitwise equality of two arrays
+static bool same(const std::vector<float>& a, const std::vector<float>& b) {
+    return memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// @brief equal values; fmsub and Dekker's split give an exact error term of
+// zero with different signs, which memcmp would count as a difference
+static bool equal(const std::vector<float>& a, const std::vector<float>& b) {
+    for (size_t i = 0; i < a.size(); ++i)
+        if (!(a[i] == b[i]))
+            return false;
+    return true;
+}
+
+int exp_kernels_check(const ExpKernels& k, unsigned long n, double& max_err) {
+    const ExpKernels& ref = exp_kernels_0;
+    std::mt19937 mt(42);
+    std::uniform_real_distribution<float> u(-1, 1);
+    std::vector<float> a(n), b(n), c(n), d(n), m(n);
+    std::vector<float> x(n), y(n), rx(n), ry(n);
+    int failed = 0;
+
+    // wide exponent range and mixed signs, so the magnitude order and the
+    // cancellation cases of the kernels are all exercised
+    for (unsigned long i = 0; i < n; ++i) {
+        a[i] = ldexpf(u(mt), (int)(mt() % 33) - 16);
+        b[i] = ldexpf(u(mt), (int)(mt() % 33) - 16);
+        c[i] = ldexpf(a[i], -26) * u(mt);
+        d[i] = ldexpf(b[i], -26) * u(mt);
+        m[i] = fabsf(a[i]) + fabsf(b[i]);
+    }
+
+    k.two_sum_array(a.data(), b.data(), x.data(), y.data(), n);
+    ref.two_sum_array(a.data(), b.data(), rx.data(), ry.data(), n);
+    failed += !(same(x, rx) && same(y, ry));
+
+    k.fast_two_sum_array(a.data(), b.data(), x.data(), y.data(), n);
+    ref.fast_two_sum_array(a.data(), b.data(), rx.data(), ry.data(), n);
+    failed += !(same(x, rx) && same(y, ry));
+
+    // two_product is error-free with or without fma, so the products, and
+    // everything built on them, are the same on every ISA
+    k.two_product_array(a.data(), b.data(), x.data(), y.data(), n);
+    ref.two_product_array(a.data(), b.data(), rx.data(), ry.data(), n);
+    failed += !(same(x, rx) && equal(y, ry));
+
+    // (a, c) as expansions, updated in place
+    x = a; y = c; rx = a; ry = c;
+    k.grow_expansion_array(x.data(), y.data(), b.data(), n);
+    ref.grow_expansion_array(rx.data(), ry.data(), b.data(), n);
+    failed += !(same(x, rx) && same(y, ry));
+
+    x = a; y = c; rx = a; ry = c;
+    k.fast_expansion_sum_array(x.data(), y.data(), b.data(), d.data(), n);
+    ref.fast_expansion_sum_array(rx.data(), ry.data(), b.data(), d.data(), n);
+    failed += !(same(x, rx) && same(y, ry));
+
+    x = a; y = c; rx = a; ry = c;
+    k.scale_expansion_array(x.data(), y.data(), 0.7f, n);
+    ref.scale_expansion_array(rx.data(), ry.data(), 0.7f, n);
+    failed += !(same(x, rx) && same(y, ry));
+
+    x = a; y = c; rx = a; ry = c;
+    k.daxpy_array(x.data(), y.data(), 0.7f, b.data(), n);
+    ref.daxpy_array(rx.data(), ry.data(), 0.7f, b.data(), n);
+    failed += !(same(x, rx) && same(y, ry));
+
+    x = a; y = c; rx = a; ry = c;
+    k.exp_axpy_array(x.data(), y.data(), b.data(), 0.7f, n);
+    ref.exp_axpy_array(rx.data(), ry.data(), b.data(), 0.7f, n);
+    failed += !(same(x, rx) && same(y, ry));
+
+    x = a; y = c; rx = a; ry = c;
+    std::vector<float> q1(b), q2(d), rq1(b), rq2(d);
+    k.lsrk_update(q1.data(), q2.data(), x.data(), y.data(), m.data(), -0.4f, 0.7f, 0.01f, n);
+    ref.lsrk_update(rq1.data(), rq2.data(), rx.data(), ry.data(), m.data(), -0.4f, 0.7f, 0.01f, n);
+    failed += !(same(x, rx) && same(y, ry) && same(q1, rq1) && same(q2, rq2));
+
+    // gemm sums every element of C over k in the same order on every ISA;
+    // sizes off the vector width and across a GEMM_KC block
+    const unsigned int gm = 37, gn = 45, gk = 300;
+    if (n >= (unsigned long)gk * gn) {
+        std::vector<float> C1(gm * gn), C2(gm * gn), R1(gm * gn), R2(gm * gn);
+        k.exp_gemm(gm, gn, gk, a.data(), c.data(), b.data(), d.data(), C1.data(), C2.data());
+        ref.exp_gemm(gm, gn, gk, a.data(), c.data(), b.data(), d.data(), R1.data(), R2.data());
+        failed += !(same(C1, R1) && same(C2, R2));
+    }
+
+    // the reductions use one accumulator per lane, so they differ between
+    // ISAs in the last bits; compare against the exact sum instead. The
+    // accumulators drop the rounding error of their low term, so the bound
+    // grows with n.
+    double tol = n * ldexp(1.0, -44);
+    __float128 sum = 0, dot = 0;
+    double norm_s = 0, norm_d = 0;
+    float r1, r2;
+    for (unsigned long i = 0; i < n; ++i) {
+        sum += a[i];
+        dot += (__float128)a[i] * b[i];
+        norm_s += fabs(a[i]);
+        norm_d += fabs((double)a[i] * b[i]);
+    }
+
+    max_err = 0.0;
+    k.exp_sum(a.data(), n, r1, r2);
+    double err = fabs((double)(((__float128)r1 + r2) - sum)) / norm_s;
+    max_err = std::max(max_err, err);
+    failed += !(err <= tol);
+
+    k.exp_dot(a.data(), b.data(), n, r1, r2);
+    err = fabs((double)(((__float128)r1 + r2) - dot)) / norm_d;
+    max_err = std::max(max_err, err);
+    failed += !(err <= tol);
+
+    // Horner has no error-free steps to differ in, so it must match bitwise.
+    // Compensated Horner is checked against the exact p(x) for random
+    // coefficients at the unrolled degree 8 and the generic degree 20, and
+    // for (x - 1)^8 expanded, at points around its 8-fold root.
+    const int degrees[3] = {8, 20, 8};
+    const float root8[9] = {1, -8, 28, -56, 70, -56, 28, -8, 1};
+    std::vector<float> coef(21);
+    for (int t = 0; t < 3; ++t) {
+        int deg = degrees[t];
+        for (int j = 0; j <= deg; ++j)
+            coef[j] = t < 2 ? u(mt) : root8[j];
+        for (unsigned long i = 0; i < n; ++i)
+            m[i] = t < 2 ? 1.25f * u(mt) : 1.0f + ldexpf(u(mt), -4);
+
+        k.horner_array(coef.data(), deg, m.data(), x.data(), n);
+        ref.horner_array(coef.data(), deg, m.data(), rx.data(), n);
+        failed += !same(x, rx);
+
+        k.comp_horner_array(coef.data(), deg, m.data(), x.data(), y.data(), n);
+        bool ok = true;
+        for (unsigned long i = 0; i < n && ok; ++i) {
+            __float128 p = 0, pabs = 0;
+            for (int j = deg; j >= 0; --j) {
+                p = p * m[i] + coef[j];
+                pabs = pabs * fabsf(m[i]) + fabsf(coef[j]);
+            }
+            // the bound of comp_horner, which needs an exact two_product
+            err = fabs((double)(((__float128)x[i] + y[i]) - p));
+            ok = err <= ldexp(fabs((double)p), -24) + ldexp(4.0 * deg * deg * (double)pabs, -48);
+        }
+        failed += !ok;
+    }
+
+    return failed;
+}
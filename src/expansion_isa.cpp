@@ -0,0 +1,67 @@
+// The batched kernels of expansion_simd.h, exp_gemm_simd of expansion_blas.h
+// and lsrk_update of test_apps.h for one instruction set. CMake compiles this
+// file once per ISA with its flags and EXP_ISA set to one of the exp_isa
+// values; the headers are included inside a namespace of their own so the
+// inline functions of different builds never get merged. The system headers
+// they use are included first, outside it.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <expansion_dispatch.h>
+
+#ifndef EXP_ISA
+#error "EXP_ISA must be set, see CMakeLists.txt"
+#endif
+
+#define EXP_ISA_CAT2(a, b) a ## b
+#define EXP_ISA_CAT(a, b)  EXP_ISA_CAT2(a, b)
+#define EXP_ISA_NS         EXP_ISA_CAT(exp_isa_, EXP_ISA)
+
+namespace EXP_ISA_NS {
+#include <expansion_math.h>
+#include <expansion_simd.h>
+#include <expansion_blas.h>
+#include <test_apps.h>
+}
+
+extern const ExpKernels EXP_ISA_CAT(exp_kernels_, EXP_ISA);
+
+const ExpKernels EXP_ISA_CAT(exp_kernels_, EXP_ISA) = {
+    (exp_isa)EXP_ISA,
+    EXP_ISA == EXP_ISA_SCALAR ? "scalar" : EXP_ISA == EXP_ISA_SSE41 ? "sse41" : EXP_ISA == EXP_ISA_AVX2 ? "avx2"
+        : EXP_ISA == EXP_ISA_AVX2FMA ? "avx2fma" : "avx512",
+    EXP_SIMD_WIDTH,
+#if defined(__AVX512F__) || defined(__FMA__)
+    true,
+#else
+    false,
+#endif
+    EXP_ISA_NS::two_sum_array,
+    EXP_ISA_NS::fast_two_sum_array,
+    EXP_ISA_NS::two_product_array,
+    EXP_ISA_NS::grow_expansion_array,
+    EXP_ISA_NS::fast_expansion_sum_array,
+    EXP_ISA_NS::scale_expansion_array,
+    EXP_ISA_NS::daxpy_array,
+    EXP_ISA_NS::exp_axpy_array,
+    EXP_ISA_NS::exp_sum_simd,
+    EXP_ISA_NS::exp_dot_simd,
+    EXP_ISA_NS::horner_array,
+    EXP_ISA_NS::comp_horner_array,
+    EXP_ISA_NS::exp_gemm_simd,
+    EXP_ISA_NS::lsrk_update,
+};
@@ -5,6 +5,20 @@
 
 #include <utils.h>
 #include <expansion_math.h>
+#include <expansion_simd.h>
+#include <expansion.h>
+#include <expansion_parallel.h>
+#include <expansion_repro.h>
+#include <expansion_blas.h>
+#include <expansion_elementary.h>
+#include <expansion_sum.h>
+#include <adaptive_array.h>
+#include <hierarchical.h>
+#include <hfp_stream.h>
+#include <expansion_file.h>
+#include <datagen.h>
+#include <perf_counters.h>
+#include <expansion_dispatch.h>
 #include <test_apps.h>
 #include <iostream>
 #include <iomanip>
@@ -19,7 +33,17 @@
 #include <drecho.h>
 
 #define N 1000000
-#define CPU_SPEED 2.2E+09
+
+// largest matrix size for the gemv stage; 2048 needs ~50 MB, the big sweep is
+// opt-in with e.g. -DGEMV_MAX=16384 (~3 GB)
+#ifndef GEMV_MAX
+#define GEMV_MAX 2048
+#endif
+
+// largest n for the in-memory Hierarchical-FP stages, 64M quads are 1 GB
+#ifndef HFP_MEM_MAX
+#define HFP_MEM_MAX (1ul << 26)
+#endif
 
 typedef unsigned __int128 uint128_t;
 typedef unsigned long uint64;
@@ -51,6 +75,182 @@ typename std::enable_if<!std::numeric_limits<T>::is_integer, bool>::type
 }
 
 
+// @brief one line of counters between r0 and r1 next to a timing, if EXPFLOAT_PERF is set
+static void print_counters(const char* label, const PerfReading& r0, const PerfReading& r1, double items)
+{
+    if (perf_counters().enabled())
+        std::cout << "counters " << label << ": " << perf_counters().report(r0, r1, items) << std::endl;
+}
+
+// @brief encode v[0..n) with HfpCodec at tolerance tol, then check the round
+// trip and random access and print size, ratio and throughput
+template <typename H>
+static void hfp_report(const char* label, const H* v, unsigned long n, H tol)
+{
+    HfpCodec<H> codec(tol);
+    H* r = new H[n];
+    uint64_t t1, t2, t3;
+    double err = 0.0;
+    unsigned long bad = 0;
+    std::streamsize prec = std::cout.precision();
+
+    t1 = timer_ticks();
+    codec.encode(v, n);
+    t2 = timer_ticks();
+    codec.decode(r);
+    t3 = timer_ticks();
+
+    // lossless means bitwise, otherwise within tol
+    for (unsigned long i = 0; i < n; ++i) {
+        H d = v[i] > r[i] ? v[i] - r[i] : r[i] - v[i];
+        err = std::max(err, (double)d);
+        bad += tol == 0 ? memcmp(&r[i], &v[i], sizeof(H)) != 0 : !(d <= tol);
+    }
+    // and a few random values through their block only
+    std::mt19937 mt(7);
+    for (int k = 0; k < 1000 && n; ++k) {
+        unsigned long i = mt() % n;
+        H g = codec.get(i);
+        bad += memcmp(&g, &r[i], sizeof(H)) != 0;
+    }
+
+    std::cout << "\t" << label << " tol " << (double)tol << ":\t" << codec.bytes() << " bytes, ratio "
+              << std::setprecision(4) << codec.ratio() << ", tags " << codec.count(0) << "/" << codec.count(1)
+              << "/" << codec.count(2) << "/" << codec.count(3) << std::endl;
+    std::cout << "\t  encode:\t" << timer_report(t2 - t1, n) << ", "
+              << n * sizeof(H) / timer_seconds(t2 - t1) * 1e-9 << " GB/s" << std::endl;
+    std::cout << "\t  decode:\t" << timer_report(t3 - t2, n) << ", "
+              << n * sizeof(H) / timer_seconds(t3 - t2) * 1e-9 << " GB/s" << std::endl;
+    std::cout << "\t  " << (bad ? "error: " : "") << "round trip: max error " << err
+              << ", " << bad << " values off" << std::endl;
+    std::cout.precision(prec);
+    delete[] r;
+}
+
+// @brief f on n arguments in [lo, hi): the batched double-double version and
+// libquadmath's, timed, and the largest relative errors of double-double in
+// units of 2^-106 and of quad-double in units of 2^-112 (an ulp of __float128)
+static void elementary_report(const char* label, unsigned long n, double lo, double hi,
+                              void (*dd)(const ExpansionArray<double, 2>&, ExpansionArray<double, 2>&),
+                              QuadDouble (*qd)(const QuadDouble&), __float128 (*quad)(__float128))
+{
+    std::vector<double> u(n), w(n);
+    std::vector<__float128> x(n), ref(n);
+    ExpansionArray<double, 2> a(n), r(n);
+    uint64_t t1, t2, t3;
+    double err_dd = 0, err_qd = 0;
+    std::streamsize prec = std::cout.precision();
+
+    gen_uniform(u.data(), n, gen_seed() + 25);
+    gen_uniform(w.data(), n, gen_seed() + 26);
+    for (unsigned long i = 0; i < n; ++i) {
+        a.set(i, to_expansion<double, 2>(lo + (__float128)(hi - lo) * (u[i] + w[i] * ldexp(1.0, -53))));
+        x[i] = a.get(i).value<__float128>();
+    }
+
+    t1 = timer_ticks();
+    for (unsigned long i = 0; i < n; ++i)
+        ref[i] = quad(x[i]);
+    t2 = timer_ticks();
+    dd(a, r);
+    t3 = timer_ticks();
+
+    for (unsigned long i = 0; i < n; ++i) {
+        __float128 q = qd(to_expansion<double, 4>(x[i])).value<__float128>();
+        err_dd = std::max(err_dd, (double)fabsq((r.get(i).value<__float128>() - ref[i]) / ref[i]) * ldexp(1.0, 106));
+        err_qd = std::max(err_qd, (double)fabsq((q - ref[i]) / ref[i]) * ldexp(1.0, 112));
+    }
+
+    std::cout << label << " on [" << lo << ", " << hi << "): max error " << std::setprecision(3) << err_dd
+              << " ulp (dd), " << err_qd << " ulp of quad (qd)" << std::endl;
+    std::cout << "time (" << label << ", quad): " << timer_report(t2 - t1, n) << std::endl;
+    std::cout << "time (" << label << ", dd " << exp_num_threads() << " threads): " << timer_report(t3 - t2, n) << std::endl;
+    std::cout.precision(prec);
+}
+
+// @brief p(x) with the degree+1 coefficients coef at the n points x: float
+// Horner, double Horner and compensated Horner (selected kernels), timed, and
+// the mean relative error of each against __float128, capped at 1 per point,
+// and the largest compensated error relative to the bound of comp_horner
+static void horner_report(const char* label, const float* coef, int degree, const float* x, unsigned long n)
+{
+    std::vector<float> y(n), r1(n), r2(n);
+    std::vector<double> dcoef(coef, coef + degree + 1), yd(n);
+    uint64_t t1, t2, t3, t4;
+    double err_f = 0, err_d = 0, err_c = 0, ratio = 0, u = ldexp(1.0, -24);
+    std::streamsize prec = std::cout.precision();
+
+    t1 = timer_ticks();
+    exp_kernels().horner_array(coef, degree, x, y.data(), n);
+    t2 = timer_ticks();
+    for (unsigned long i = 0; i < n; ++i)
+        yd[i] = horner(dcoef.data(), degree, (double)x[i]);
+    t3 = timer_ticks();
+    exp_kernels().comp_horner_array(coef, degree, x, r1.data(), r2.data(), n);
+    t4 = timer_ticks();
+
+    for (unsigned long i = 0; i < n; ++i) {
+        __float128 p = 0, pabs = 0;
+        for (int j = degree; j >= 0; --j) {
+            p = p * x[i] + coef[j];
+            pabs = pabs * fabsf(x[i]) + fabsf(coef[j]);
+        }
+        err_f += std::min(1.0, (double)fabsq((y[i] - p) / p));
+        err_d += std::min(1.0, (double)fabsq((yd[i] - p) / p));
+        err_c += std::min(1.0, (double)fabsq(((__float128)r1[i] + r2[i] - p) / p));
+        ratio = std::max(ratio, (double)fabsq((__float128)r1[i] + r2[i] - p) /
+                                (u * (double)fabsq(p) + 4.0 * degree * degree * u * u * (double)pabs));
+    }
+
+    std::cout << label << ": mean rel. error " << std::setprecision(3) << err_f / n << " (float), "
+              << err_d / n << " (double), " << err_c / n << " (compensated)" << std::endl;
+    std::cout << (ratio > 1 ? "error: " : "") << label << ": compensated error / bound at most " << ratio << std::endl;
+    std::cout << "time (" << label << ", float):       " << timer_report(t2 - t1, n) << std::endl;
+    std::cout << "time (" << label << ", double):      " << timer_report(t3 - t2, n) << std::endl;
+    std::cout << "time (" << label << ", compensated): " << timer_report(t4 - t3, n) << std::endl;
+    std::cout.precision(prec);
+}
+
+// @brief every strategy of sum_strategies() on a[0..n): the best of three
+// timings and the relative error against the exact sum, as a table in which
+// the strategies no other one beats in both speed and accuracy are marked
+// as the Pareto front
+static void sum_report(const char* label, const float* a, unsigned long n)
+{
+    std::vector<SumStrategy>& st = sum_strategies();
+    std::vector<double> ns(st.size()), err(st.size());
+    __float128 exact = 0, norm = 0;
+    float r1, r2;
+    std::streamsize prec = std::cout.precision();
+
+    for (unsigned long i = 0; i < n; ++i) {
+        exact += a[i];
+        norm += fabsq(a[i]);
+    }
+    std::cout << label << ": condition number " << std::setprecision(3) << (double)(norm / fabsq(exact)) << std::endl;
+
+    for (size_t k = 0; k < st.size(); ++k) {
+        uint64_t best = ~0ull;
+        for (int rep = 0; rep < 3; ++rep) {
+            uint64_t t1 = timer_ticks();
+            st[k].sum(a, n, r1, r2);
+            best = std::min(best, timer_ticks() - t1);
+        }
+        ns[k] = timer_seconds(best) / n * 1e9;
+        err[k] = (double)fabsq(((__float128)r1 + r2 - exact) / exact);
+    }
+
+    std::cout << "  strategy        ns/elem   rel. error" << std::endl;
+    for (size_t k = 0; k < st.size(); ++k) {
+        bool front = true;
+        for (size_t j = 0; j < st.size() && front; ++j)
+            front = !(ns[j] <= ns[k] && err[j] <= err[k] && (ns[j] < ns[k] || err[j] < err[k]));
+        std::cout << "  " << std::left << std::setw(15) << st[k].name << std::right << std::setw(8)
+                  << std::setprecision(3) << ns[k] << std::setw(13) << err[k] << (front ? "  *" : "") << std::endl;
+    }
+    std::cout.precision(prec);
+}
+
 static int print_u128_u(uint128_t u128)
 {
     int rc;
@@ -79,7 +279,8 @@ int main(int argc, char* argv[]) {
   float *arr2 = (float *) malloc(N * sizeof(float));
   double *darr1 = (double *) malloc(N * sizeof(double));
   double *darr2 = (double *) malloc(N * sizeof(double));
-  double t1, t2, t3, t4;
+  uint64_t t1, t2, t3, t4, t5;
+  PerfReading p1, p2, p3, p4, p5;
 
   std::random_device rd;
   std::mt19937 mt(rd());
@@ -95,6 +296,14 @@ int main(int argc, char* argv[]) {
 
   dr::capture(std::cout);
 
+  if (timer_info().tsc)
+	  std::cout << "[info] timer: invariant TSC, " << std::setprecision(4) << timer_info().frequency * 1e-9 << " GHz" << std::endl;
+  else
+	  std::cout << "[info] timer: steady_clock, no cycle counts" << std::endl;
+  if (perf_counters().enabled())
+	  std::cout << "[info] perf counters: on" << std::endl;
+  std::cout << "[info] data seed: " << gen_seed() << (gen_cache_path("").empty() ? "" : ", cached") << std::endl;
+
 
   std::cout << "Stage  a+b " << std::endl;
   { 
@@ -121,28 +330,30 @@ int main(int argc, char* argv[]) {
   std::cout << "Stage  sum(a) " << std::endl;
   {
 	  dr::tab scope;
+	  gen_uniform(darr1, N, gen_seed());
+	  gen_uniform(darr2, N, gen_seed() + 1);
 	  for (i = 0; i < N; ++i) {
-            da = dist(mt);
-	    a = da;
-	    arr1[i] = a;
-	    darr1[i] = da;
-
-	    da = dist(mt);
-	    a = da;
-	    arr2[i] = a;
-	    darr2[i] = da;
+	    arr1[i] = darr1[i];
+	    arr2[i] = darr2[i];
 	  }
 
-	  t1 = rdtsc();
+	  p1 = perf_counters().read();
+	  t1 = timer_ticks();
 	  for (i = 0; i < N; ++i)
             sum = sum + arr1[i];
-	  t2 = rdtsc();
+	  t2 = timer_ticks();
+	  p2 = perf_counters().read();
 	  for (i = 0; i < N; ++i)
 	    dsum = dsum + darr1[i];
-	  t3 = rdtsc();
+	  t3 = timer_ticks();
+	  p3 = perf_counters().read();
 	  for (i = 0; i < N; ++i)
 	    grow_expansion(e1, e2, arr1[i]);
-	  t4 = rdtsc();
+	  t4 = timer_ticks();
+	  p4 = perf_counters().read();
+	  exp_sum_simd(arr1, N, x, y);
+	  t5 = timer_ticks();
+	  p5 = perf_counters().read();
 
 	  std::cout << "sum: " << std::setprecision(8) << sum << ", dsum: " << std::setprecision(15) << dsum << std::endl; 
 	  std::cout << "expansion: " <<  std::setprecision(8) << e1 << ", " << e2 << std::endl;
@@ -151,7 +362,106 @@ int main(int argc, char* argv[]) {
 	  // printf("expansion: %.8f, %.8e\n", e1, e2);
 	  // printf("delta: %.9g\n", dsum - e1);
 
-	  std::cout << "time: " <<  (t2 - t1) / CPU_SPEED << ", " << (t3 - t2) / CPU_SPEED << ", " << (t4 - t3) / CPU_SPEED << std::endl;
+	  std::cout << "time (float):  " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (double): " << timer_report(t3 - t2, N) << std::endl;
+	  std::cout << "time (exp):    " << timer_report(t4 - t3, N) << std::endl;
+	  print_counters("(float)", p1, p2, N);
+	  print_counters("(double)", p2, p3, N);
+	  print_counters("(exp)", p3, p4, N);
+
+	  std::cout << "expansion (simd x" << EXP_SIMD_WIDTH << "): " <<  std::setprecision(8) << x << ", " << y << std::endl;
+	  std::cout << "time (simd): " << timer_report(t5 - t4, N) << std::endl;
+	  print_counters("(simd)", p4, p5, N);
+
+	  float x4, y4, x8, y8;
+	  t1 = timer_ticks();
+	  exp_sum_lanes<4>(arr1, N, x4, y4);
+	  t2 = timer_ticks();
+	  exp_sum_lanes<8>(arr1, N, x8, y8);
+	  t3 = timer_ticks();
+	  exp_sum_lanes<16>(arr1, N, x, y);
+	  t4 = timer_ticks();
+
+	  std::cout << "expansion (lanes 4):  " <<  std::setprecision(8) << x4 << ", " << y4
+		    << ", delta: " << std::setprecision(9) << dsum - ((double)x4 + y4) << std::endl;
+	  std::cout << "expansion (lanes 8):  " <<  std::setprecision(8) << x8 << ", " << y8
+		    << ", delta: " << std::setprecision(9) << dsum - ((double)x8 + y8) << std::endl;
+	  std::cout << "expansion (lanes 16): " <<  std::setprecision(8) << x << ", " << y
+		    << ", delta: " << std::setprecision(9) << dsum - ((double)x + y) << std::endl;
+	  std::cout << "time (lanes 4):  " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (lanes 8):  " << timer_report(t3 - t2, N) << std::endl;
+	  std::cout << "time (lanes 16): " << timer_report(t4 - t3, N) << std::endl;
+
+	  Expansion<float, 2> ef2;
+	  Expansion<float, 3> ef3;
+	  Expansion<double, 2> ed2;
+	  t1 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+	    ef2 += arr1[i];
+	  t2 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+	    ef3 += arr1[i];
+	  t3 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+	    ed2 += darr1[i];
+	  t4 = timer_ticks();
+
+	  std::cout << "Expansion<float,2>: " <<  std::setprecision(8) << ef2[0] << ", " << ef2[1] << std::endl;
+	  std::cout << "Expansion<float,3>: " <<  std::setprecision(8) << ef3[0] << ", " << ef3[1] << ", " << ef3[2] << std::endl;
+	  std::cout << "Expansion<double,2>: " <<  std::setprecision(17) << ed2[0] << ", " << ed2[1] << std::endl;
+	  std::cout << "time (Expansion f2): " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (Expansion f3): " << timer_report(t3 - t2, N) << std::endl;
+	  std::cout << "time (Expansion d2): " << timer_report(t4 - t3, N) << std::endl;
+
+	  t1 = timer_ticks();
+	  exp_sum_parallel(arr1, N, x, y);
+	  t2 = timer_ticks();
+
+	  std::cout << "expansion (" << exp_num_threads() << " threads): " <<  std::setprecision(8) << x << ", " << y << std::endl;
+	  std::cout << "time (threads): " << timer_report(t2 - t1, N) << std::endl;
+
+	  t1 = timer_ticks();
+	  exp_sum_repro(arr1, N, x, y);
+	  t2 = timer_ticks();
+	  exp_sum_repro_parallel(arr1, N, a, b);
+	  t3 = timer_ticks();
+
+	  std::cout << "expansion (reproducible): " <<  std::setprecision(8) << x << ", " << y << std::endl;
+	  std::cout << "reproducible across " << exp_num_threads() << " threads: " << (x == a && y == b ? "yes" : "no") << std::endl;
+	  std::cout << "time (reproducible):          " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (reproducible, threads): " << timer_report(t3 - t2, N) << std::endl;
+
+	  // edge cases: max |a_i| >= 2^126, where E = 1.5*2^t would overflow
+	  // without the scaling, and Inf / NaN, which come back as they are
+	  float big[4] = {1e38f, 1, -3e37f, 2};
+	  float inf[3] = {1, std::numeric_limits<float>::infinity(), 2};
+	  float nan[3] = {1, std::numeric_limits<float>::quiet_NaN(), 2};
+	  exp_sum_repro(big, 4, x, y);
+	  exp_sum_repro_parallel(big, 4, a, b);
+	  dz = (double)big[0] + big[2];
+	  std::cout << (fabs((double)x + y - dz) <= 1e-14 * dz && a == x && b == y ? "" : "error: ")
+	            << "reproducible near FLT_MAX: " << std::setprecision(8) << x << ", " << y << std::endl;
+	  exp_sum_repro(inf, 3, x, y);
+	  exp_sum_repro_parallel(nan, 3, a, b);
+	  std::cout << (std::isinf(x) && x > 0 && std::isnan(a) ? "" : "error: ")
+	            << "reproducible with Inf / NaN: " << x << ", " << a << std::endl;
+  }
+  std::cout << "." << std::endl;
+
+  std::cout << "Stage  summation strategies " << std::endl;
+  {
+	  dr::tab scope;
+
+	  // uniform [0, 1) as in the sum stage, a sum with condition number
+	  // around 1e8 and one where +-x pairs up to 1e6 cancel and leave the
+	  // small values; * marks the accuracy-speed Pareto front of each
+	  std::vector<float> v(N);
+	  gen_uniform(v.data(), N, gen_seed());
+	  sum_report("uniform [0, 1)", v.data(), N);
+	  gen_ill_conditioned(v.data(), N, gen_seed() + 28, 1e8);
+	  sum_report("ill-conditioned", v.data(), N);
+	  gen_cancellation(v.data(), N, gen_seed() + 29, 1e6);
+	  sum_report("cancellation", v.data(), N);
   }
   std::cout << "." << std::endl;
 
@@ -171,19 +481,45 @@ int main(int argc, char* argv[]) {
 	  dz = da * db;
 
 	  std::cout << "dz: " << std::setprecision(14) << dz << ", delta: " << std::setprecision(9) <<  dz - x << std::endl;
+
+	  // a float product is exact in a double, so two_product and the float
+	  // expansion products must reproduce it bit for bit; exponents over
+	  // [-16, 16] and mixed signs
+	  std::vector<double> pa(N), pb(N);
+	  gen_uniform(pa.data(), N, gen_seed() + 31, -1.0, 1.0);
+	  gen_uniform(pb.data(), N, gen_seed() + 32, -1.0, 1.0);
+	  unsigned long inexact_tp = 0, inexact_e2 = 0, inexact_e3 = 0;
+	  for (i = 0; i < N; ++i) {
+		  float fa = ldexpf((float)pa[i], (int)(i % 33) - 16), fb = ldexpf((float)pb[i], (int)(i * 7 % 33) - 16);
+		  double p = (double)fa * fb;
+		  two_product(fa, fb, x, y);
+		  inexact_tp += (double)x + y != p;
+		  inexact_e2 += (Expansion<float, 2>(fa) * fb).value<double>() != p;
+		  inexact_e3 += (Expansion<float, 3>(fa) * Expansion<float, 3>(fb)).value<double>() != p;
+	  }
+	  std::cout << (inexact_tp + inexact_e2 + inexact_e3 ? "error: " : "") << "inexact float products of " << N
+		    << ": " << inexact_tp << " (two_product), " << inexact_e2 << " (Expansion<float,2> * float), "
+		    << inexact_e3 << " (Expansion<float,3> * Expansion<float,3>)" << std::endl;
   }
   std::cout << "." << std::endl;
 
   std::cout << "Stage  (a,b) " << std::endl;
   {
 	  dr::tab scope;
-	  t1 = rdtsc();
+	  p1 = perf_counters().read();
+	  t1 = timer_ticks();
 	  sum = dot(arr1, arr2, N);
-	  t2 = rdtsc();
+	  t2 = timer_ticks();
+	  p2 = perf_counters().read();
 	  dsum = dot(darr1, darr2, N);
-	  t3 = rdtsc();
+	  t3 = timer_ticks();
+	  p3 = perf_counters().read();
 	  exp_dot(arr1, arr2, N, e1, e2);
-	  t4 = rdtsc();
+	  t4 = timer_ticks();
+	  p4 = perf_counters().read();
+	  exp_dot_simd(arr1, arr2, N, x, y);
+	  t5 = timer_ticks();
+	  p5 = perf_counters().read();
 
 	  std::cout << "sum: " << std::setprecision(8) << sum << ", dsum: " << std::setprecision(15) << dsum << std::endl;
 	  std::cout << "expansion: " <<  std::setprecision(8) << e1 << ", " << e2 << std::endl;
@@ -191,8 +527,42 @@ int main(int argc, char* argv[]) {
 	  // printf("sum: %.8f, dsum: %.15g \n", sum, dsum);
 	  // printf("expansion: %.8f, %.8e\n", e1, e2);
 	  // printf("delta: %.9g\n", dsum - e1);
-	  // printf("times: %g, %g, %g\n", (t2 - t1) / CPU_SPEED, (t3 - t2) / CPU_SPEED, (t4 - t3) / CPU_SPEED);
-	  std::cout << "time: " <<  (t2 - t1) / CPU_SPEED << ", " << (t3 - t2) / CPU_SPEED << ", " << (t4 - t3) / CPU_SPEED << std::endl;
+	  std::cout << "time (float):  " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (double): " << timer_report(t3 - t2, N) << std::endl;
+	  std::cout << "time (exp):    " << timer_report(t4 - t3, N) << std::endl;
+	  print_counters("(float)", p1, p2, N);
+	  print_counters("(double)", p2, p3, N);
+	  print_counters("(exp)", p3, p4, N);
+
+	  std::cout << "expansion (simd x" << EXP_SIMD_WIDTH << "): " <<  std::setprecision(8) << x << ", " << y << std::endl;
+	  std::cout << "time (simd): " << timer_report(t5 - t4, N) << std::endl;
+	  print_counters("(simd)", p4, p5, N);
+
+	  float x4, y4, x8, y8;
+	  t1 = timer_ticks();
+	  exp_dot_lanes<4>(arr1, arr2, N, x4, y4);
+	  t2 = timer_ticks();
+	  exp_dot_lanes<8>(arr1, arr2, N, x8, y8);
+	  t3 = timer_ticks();
+	  exp_dot_lanes<16>(arr1, arr2, N, x, y);
+	  t4 = timer_ticks();
+
+	  std::cout << "expansion (lanes 4):  " <<  std::setprecision(8) << x4 << ", " << y4
+		    << ", delta: " << std::setprecision(9) << dsum - ((double)x4 + y4) << std::endl;
+	  std::cout << "expansion (lanes 8):  " <<  std::setprecision(8) << x8 << ", " << y8
+		    << ", delta: " << std::setprecision(9) << dsum - ((double)x8 + y8) << std::endl;
+	  std::cout << "expansion (lanes 16): " <<  std::setprecision(8) << x << ", " << y
+		    << ", delta: " << std::setprecision(9) << dsum - ((double)x + y) << std::endl;
+	  std::cout << "time (lanes 4):  " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (lanes 8):  " << timer_report(t3 - t2, N) << std::endl;
+	  std::cout << "time (lanes 16): " << timer_report(t4 - t3, N) << std::endl;
+
+	  t1 = timer_ticks();
+	  exp_dot_parallel(arr1, arr2, N, x, y);
+	  t2 = timer_ticks();
+
+	  std::cout << "expansion (" << exp_num_threads() << " threads): " <<  std::setprecision(8) << x << ", " << y << std::endl;
+	  std::cout << "time (threads): " << timer_report(t2 - t1, N) << std::endl;
 
 
 	  free(arr1);
@@ -202,7 +572,351 @@ int main(int argc, char* argv[]) {
   }
   std::cout << "." << std::endl;
 
-  
+
+  std::cout << "Stage  double-double " << std::endl;
+  {
+	  dr::tab scope;
+
+	  // the same dot product and element-wise products in __float128 (software)
+	  // and in double-double / quad-double expansions (hardware doubles)
+	  std::vector<double> xd(N), yd(N);
+	  gen_uniform(xd.data(), N, gen_seed() + 21);
+	  gen_uniform(yd.data(), N, gen_seed() + 22);
+
+	  __float128 qdot = 0;
+	  char buf[128];
+	  DoubleDouble dd_dot;
+	  QuadDouble qd_dot;
+	  t1 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+		  qdot += (__float128)xd[i] * yd[i];
+	  t2 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+		  dd_dot += DoubleDouble(xd[i]) * yd[i];
+	  t3 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+		  qd_dot += QuadDouble(xd[i]) * yd[i];
+	  t4 = timer_ticks();
+
+	  quadmath_snprintf(buf, sizeof(buf), "%.36Qg", qdot);
+	  std::cout << "dot (quad): " << buf << std::endl;
+	  std::cout << "rel. error (dd): " << std::setprecision(3) << (double)fabsq((dd_dot.value<__float128>() - qdot) / qdot)
+	            << ", (qd): " << (double)fabsq((qd_dot.value<__float128>() - qdot) / qdot) << std::endl;
+	  std::cout << "time (quad dot): " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (dd dot):   " << timer_report(t3 - t2, N) << std::endl;
+	  std::cout << "time (qd dot):   " << timer_report(t4 - t3, N) << std::endl;
+
+	  // full-width operands: the low word is 2^-53 of a second uniform value
+	  std::vector<__float128> qa(N), qb(N), qc(N);
+	  std::vector<DoubleDouble> da2(N), db2(N), dc2(N);
+	  for (i = 0; i < N; ++i) {
+		  qa[i] = (__float128)xd[i] + (__float128)yd[i] * ldexp(1.0, -53);
+		  qb[i] = (__float128)yd[i] + (__float128)xd[i] * ldexp(1.0, -53);
+		  da2[i] = to_expansion<double, 2>(qa[i]);
+		  db2[i] = to_expansion<double, 2>(qb[i]);
+	  }
+	  t1 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+		  qc[i] = qa[i] * qb[i];
+	  t2 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+		  dc2[i] = da2[i] * db2[i];
+	  t3 = timer_ticks();
+
+	  double err = 0;
+	  for (i = 0; i < N; ++i)
+		  err = std::max(err, (double)fabsq((dc2[i].value<__float128>() - qc[i]) / qc[i]));
+	  std::cout << "max rel. error (dd a*b): " << std::setprecision(3) << err << std::endl;
+	  std::cout << "time (quad a*b): " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (dd a*b):   " << timer_report(t3 - t2, N) << std::endl;
+  }
+  std::cout << "." << std::endl;
+
+  std::cout << "Stage  division and sqrt " << std::endl;
+  {
+	  dr::tab scope;
+
+	  // a / b and sqrt(a) by Newton iteration in double-double, against
+	  // libquadmath; b is kept in [1, 2)
+	  std::vector<double> xd(N), yd(N);
+	  gen_uniform(xd.data(), N, gen_seed() + 23);
+	  gen_uniform(yd.data(), N, gen_seed() + 24);
+
+	  std::vector<__float128> qa(N), qb(N), qc(N), qs(N);
+	  ExpansionArray<double, 2> da(N), db(N), dq(N), ds(N);
+	  for (i = 0; i < N; ++i) {
+		  qa[i] = (__float128)xd[i] + (__float128)yd[i] * ldexp(1.0, -53);
+		  qb[i] = 1 + (__float128)yd[i] + (__float128)xd[i] * ldexp(1.0, -53);
+		  da.set(i, to_expansion<double, 2>(qa[i]));
+		  db.set(i, to_expansion<double, 2>(qb[i]));
+		  dq.set(i, da.get(i));
+		  ds.set(i, da.get(i));
+	  }
+
+	  t1 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+		  qc[i] = qa[i] / qb[i];
+	  t2 = timer_ticks();
+	  for (i = 0; i < N; ++i)
+		  qs[i] = sqrtq(qa[i]);
+	  t3 = timer_ticks();
+	  dq.div(db);
+	  t4 = timer_ticks();
+	  ds.sqrt();
+	  t5 = timer_ticks();
+
+	  double err_div = 0, err_sqrt = 0;
+	  for (i = 0; i < N; ++i) {
+		  err_div = std::max(err_div, (double)fabsq((dq.get(i).value<__float128>() - qc[i]) / qc[i]));
+		  err_sqrt = std::max(err_sqrt, (double)fabsq((ds.get(i).value<__float128>() - qs[i]) / qs[i]));
+	  }
+	  std::cout << "max rel. error (dd a/b): " << std::setprecision(3) << err_div << ", (dd sqrt): " << err_sqrt << std::endl;
+	  std::cout << "time (quad a/b):   " << timer_report(t2 - t1, N) << std::endl;
+	  std::cout << "time (quad sqrt):  " << timer_report(t3 - t2, N) << std::endl;
+	  std::cout << "time (dd a/b):     " << timer_report(t4 - t3, N) << std::endl;
+	  std::cout << "time (dd sqrt):    " << timer_report(t5 - t4, N) << std::endl;
+
+	  QuadDouble two(2.0), r2 = sqrt(two);
+	  std::cout << "qd sqrt(2)^2 - 2: " << std::setprecision(3) << (r2 * r2 - two).value<double>() << std::endl;
+  }
+  std::cout << "." << std::endl;
+
+  std::cout << "Stage  elementary functions " << std::endl;
+  {
+	  dr::tab scope;
+
+	  const unsigned long n = 100000;
+	  elementary_report("exp", n, -20, 20, exp_array<double, 2>, exp<double, 4>, expq);
+	  elementary_report("log", n, 0, 100, log_array<double, 2>, log<double, 4>, logq);
+	  elementary_report("sin", n, -100, 100, sin_array<double, 2>, sin<double, 4>, sinq);
+	  elementary_report("cos", n, -100, 100, cos_array<double, 2>, cos<double, 4>, cosq);
+  }
+  std::cout << "." << std::endl;
+
+  std::cout << "Stage  logging " << std::endl;
+  {
+	  dr::tab scope;
+
+	  // what a log line costs the thread that writes it: queued for the
+	  // background writer, and formatted and printed in place
+	  const int lines = 8;
+	  bool was = dr::async(true);
+	  t1 = timer_ticks();
+	  for (i = 0; i < lines; ++i)
+		  std::cout << "queued line " << i << std::endl;
+	  t2 = timer_ticks();
+	  dr::async(false);
+	  t3 = timer_ticks();
+	  for (i = 0; i < lines; ++i)
+		  std::cout << "direct line " << i << std::endl;
+	  t4 = timer_ticks();
+	  dr::async(true);
+	  t5 = timer_ticks();
+	  #pragma omp parallel for
+	  for (i = 0; i < lines; ++i)
+		  std::cout << "parallel line " << i << std::endl;
+	  uint64_t t6 = timer_ticks();
+	  dr::async(was);
+
+	  std::cout << "time (queued): " << timer_report(t2 - t1, lines) << std::endl;
+	  std::cout << "time (direct): " << timer_report(t4 - t3, lines) << std::endl;
+	  std::cout << "time (" << exp_num_threads() << " threads): " << timer_report(t6 - t5, lines) << std::endl;
+  }
+  std::cout << "." << std::endl;
+
+
+  std::cout << "Stage  dispatch " << std::endl;
+  {
+	  dr::tab scope;
+
+	  std::cout << "[info] selected kernels: " << exp_kernels().name << " (x" << exp_kernels().width << ")" << std::endl;
+
+	  std::vector<float> a1(N), b1(N), x1(N), x2(N);
+	  for (i = 0; i < N; ++i) {
+		  a1[i] = dist(mt);
+		  b1[i] = dist(mt);
+	  }
+
+	  for (int k = 0; k < EXP_NUM_ISAS; ++k) {
+		  const ExpKernels* kern = exp_kernels_for((exp_isa)k);
+		  if (!kern)
+			  continue;
+		  double err;
+		  int failed = exp_kernels_check(*kern, 100003, err);
+
+		  std::fill(x1.begin(), x1.end(), 0.0f);
+		  std::fill(x2.begin(), x2.end(), 0.0f);
+		  t1 = timer_ticks();
+		  kern->exp_sum(a1.data(), N, x, y);
+		  t2 = timer_ticks();
+		  kern->daxpy_array(x1.data(), x2.data(), 0.999f, b1.data(), N);
+		  t3 = timer_ticks();
+
+		  dr::tab scope2;
+		  std::cout << kern->name << " (x" << kern->width << (kern->fma ? ", fma" : "") << "): "
+			    << (failed ? "error: " : "") << failed << " failed checks, max reduction error "
+			    << std::setprecision(3) << err << std::endl;
+		  std::cout << "time (sum):   " << timer_report(t2 - t1, N) << std::endl;
+		  std::cout << "time (daxpy): " << timer_report(t3 - t2, N) << std::endl;
+	  }
+  }
+  std::cout << "." << std::endl;
+
+  std::cout << "Stage  Horner " << std::endl;
+  {
+	  dr::tab scope;
+
+	  // random coefficients at the unrolled degree 8 and the generic degree 24
+	  // on [-1, 1), and (x - 1)^8 expanded on 1 +- 1/4, around its 8-fold
+	  // root, where the condition number (2 / |x - 1|)^8 grows without bound
+	  std::vector<double> u(N);
+	  std::vector<float> xs(N), coef(25);
+	  const float root8[9] = {1, -8, 28, -56, 70, -56, 28, -8, 1};
+	  gen_uniform(u.data(), N, gen_seed() + 27);
+	  gen_uniform(coef.data(), 25, gen_seed() + 30, -1.0, 1.0);
+
+	  for (i = 0; i < N; ++i)
+		  xs[i] = 2 * u[i] - 1;
+	  horner_report("degree 8", coef.data(), 8, xs.data(), N);
+	  horner_report("degree 24", coef.data(), 24, xs.data(), N);
+	  for (i = 0; i < N; ++i)
+		  xs[i] = 1 + (float)ldexp(2 * u[i] - 1, -2);
+	  horner_report("(x-1)^8", root8, 8, xs.data(), N);
+  }
+  std::cout << "." << std::endl;
+
+  std::cout << "Stage  gemv " << std::endl;
+  {
+	  dr::tab scope;
+
+	  for (unsigned int n = 1024; n <= GEMV_MAX; n *= 2) {
+		  float *fA = new float[(unsigned long)n * n];
+		  double *dA = new double[(unsigned long)n * n];
+		  float *fx = new float[n], *fy = new float[n], *y1 = new float[n], *y2 = new float[n];
+		  double *dx = new double[n], *dy = new double[n];
+		  double err_f = 0.0, err_r = 0.0, err_c = 0.0;
+
+		  for (unsigned long k = 0; k < (unsigned long)n * n; ++k)
+			  dA[k] = fA[k] = dist(mt) - 0.5;
+		  for (unsigned int k = 0; k < n; ++k)
+			  dx[k] = fx[k] = dist(mt) - 0.5;
+
+		  dr::tab scope2;
+		  std::cout << "n = " << n << std::endl;
+
+		  t1 = timer_ticks();
+		  gemv(EXP_ROW_MAJOR, n, n, fA, fx, fy);
+		  t2 = timer_ticks();
+		  gemv(EXP_ROW_MAJOR, n, n, dA, dx, dy);
+		  t3 = timer_ticks();
+		  p3 = perf_counters().read();
+		  exp_gemv(EXP_ROW_MAJOR, n, n, fA, fx, y1, y2);
+		  t4 = timer_ticks();
+		  p4 = perf_counters().read();
+
+		  for (unsigned int k = 0; k < n; ++k) {
+			  err_f = std::max(err_f, std::abs(fy[k] - dy[k]));
+			  err_r = std::max(err_r, std::abs(((double)y1[k] + y2[k]) - dy[k]));
+		  }
+
+		  std::cout << "row-major max error vs double (float, exp): " << std::setprecision(4) << err_f << ", " << err_r << std::endl;
+		  std::cout << "row-major time (float):  " << timer_report(t2 - t1, (double)n * n) << std::endl;
+		  std::cout << "row-major time (double): " << timer_report(t3 - t2, (double)n * n) << std::endl;
+		  std::cout << "row-major time (exp):    " << timer_report(t4 - t3, (double)n * n) << std::endl;
+		  print_counters("row-major (exp)", p3, p4, (double)n * n);
+
+		  t1 = timer_ticks();
+		  gemv(EXP_COL_MAJOR, n, n, fA, fx, fy);
+		  t2 = timer_ticks();
+		  gemv(EXP_COL_MAJOR, n, n, dA, dx, dy);
+		  t3 = timer_ticks();
+		  exp_gemv(EXP_COL_MAJOR, n, n, fA, fx, y1, y2);
+		  t4 = timer_ticks();
+
+		  err_f = 0.0;
+		  for (unsigned int k = 0; k < n; ++k) {
+			  err_f = std::max(err_f, std::abs(fy[k] - dy[k]));
+			  err_c = std::max(err_c, std::abs(((double)y1[k] + y2[k]) - dy[k]));
+		  }
+
+		  std::cout << "col-major max error vs double (float, exp): " << std::setprecision(4) << err_f << ", " << err_c << std::endl;
+		  std::cout << "col-major time (float):  " << timer_report(t2 - t1, (double)n * n) << std::endl;
+		  std::cout << "col-major time (double): " << timer_report(t3 - t2, (double)n * n) << std::endl;
+		  std::cout << "col-major time (exp):    " << timer_report(t4 - t3, (double)n * n) << std::endl;
+
+		  delete[] fA;
+		  delete[] dA;
+		  delete[] fx;
+		  delete[] fy;
+		  delete[] y1;
+		  delete[] y2;
+		  delete[] dx;
+		  delete[] dy;
+	  }
+  }
+  std::cout << "." << std::endl;
+
+  std::cout << "Stage  gemm " << std::endl;
+  {
+	  dr::tab scope;
+
+	  // square, then rank-k updates and a tall-skinny product, which are bandwidth bound
+	  const unsigned int shapes[4][3] = { {512, 512, 512}, {2048, 2048, 16}, {4096, 4096, 4}, {16384, 16, 256} };
+
+	  for (int s = 0; s < 4; ++s) {
+		  unsigned int m = shapes[s][0], n = shapes[s][1], k = shapes[s][2];
+		  float *A1 = new float[m * k], *A2 = new float[m * k], *B1 = new float[k * n], *B2 = new float[k * n];
+		  float *C1 = new float[m * n], *C2 = new float[m * n];
+		  double *dA = new double[m * k], *dB = new double[k * n], *dC = new double[m * n];
+		  double err = 0.0, flops = 2.0 * m * n * k;
+
+		  for (unsigned int i = 0; i < m * k; ++i) {
+			  dA[i] = dist(mt) - 0.5;
+			  A1[i] = dA[i];
+			  A2[i] = dA[i] - A1[i];
+		  }
+		  for (unsigned int i = 0; i < k * n; ++i) {
+			  dB[i] = dist(mt) - 0.5;
+			  B1[i] = dB[i];
+			  B2[i] = dB[i] - B1[i];
+		  }
+
+		  dr::tab scope2;
+		  std::cout << "m, n, k = " << m << ", " << n << ", " << k << std::endl;
+
+		  t1 = timer_ticks();
+		  gemm(m, n, k, A1, B1, C1);
+		  t2 = timer_ticks();
+		  gemm(m, n, k, dA, dB, dC);
+		  t3 = timer_ticks();
+		  exp_gemm(m, n, k, A1, A2, B1, B2, C1, C2);
+		  t4 = timer_ticks();
+
+		  for (unsigned int i = 0; i < m * n; ++i)
+			  err = std::max(err, std::abs(((double)C1[i] + C2[i]) - dC[i]));
+
+		  std::cout << "max error vs double: " << std::setprecision(4) << err << std::endl;
+		  std::cout << "GFLOP/s (float, double, exp): " << std::setprecision(4)
+			    << flops / timer_seconds(t2 - t1) * 1e-9 << ", " << flops / timer_seconds(t3 - t2) * 1e-9 << ", "
+			    << flops / timer_seconds(t4 - t3) * 1e-9 << std::endl;
+		  // per multiply-add
+		  std::cout << "time (float):  " << timer_report(t2 - t1, flops / 2) << std::endl;
+		  std::cout << "time (double): " << timer_report(t3 - t2, flops / 2) << std::endl;
+		  std::cout << "time (exp):    " << timer_report(t4 - t3, flops / 2) << std::endl;
+
+		  delete[] A1;
+		  delete[] A2;
+		  delete[] B1;
+		  delete[] B2;
+		  delete[] C1;
+		  delete[] C2;
+		  delete[] dA;
+		  delete[] dB;
+		  delete[] dC;
+	  }
+  }
+  std::cout << "." << std::endl;
+
   std::cout << "Stage  Runge-Kutta " << std::endl;
   {
 	  dr::tab scope;
@@ -226,17 +940,47 @@ int main(int argc, char* argv[]) {
 		  fq[i] = q[i] = dist(mt);
 	  }
 
-	  t1 = rdtsc();
+	  float *fqtmp = new float[n * r];
+	  for (int i = 0; i < n * r; ++i)
+		  fqtmp[i] = 0.0;
+
+	  // same data for the integrator, all fields in the j*n + i layout
+	  LSRK45Exp<1> rk(n, 0.01);
+	  LSRK45Exp<1>::Workspace ws(n);
+	  ExpansionArray<float, 2> eq(n);
+	  for (int i = 0; i < n; ++i) {
+		  eq.top()[i] = fq[i];
+		  ws.qres.top()[i] = fqres[i];
+	  }
+	  // constant right hand side, as in the other tests
+	  auto rhs = [&](double, const ExpansionArray<float, 2> &, float *out) {
+		  std::copy(fqrhs, fqrhs + n, out);
+	  };
+
+	  t1 = timer_ticks();
 	  test_rk45<double, 1>(n, qres, qrhs, q);
-	  t2 = rdtsc();
+	  t2 = timer_ticks();
 	  test_rk45<float, 1>(n, fqres, fqrhs, fq);
-	  t3 = rdtsc();
-	  test_rk45_exp<1>(n, fqres, fqrhs, fq);
-	  t4 = rdtsc();
+	  t3 = timer_ticks();
+	  p3 = perf_counters().read();
+	  test_rk45_exp<1>(n, fqres, fqrhs, fq, fqtmp);
+	  t4 = timer_ticks();
+	  p4 = perf_counters().read();
+	  for (int t = 0; t < 10000; ++t)
+		  rk.step(eq, t * 0.01, rhs, ws);
+	  t5 = timer_ticks();
+	  p5 = perf_counters().read();
+
+	  // per element and stage: 10000 steps of 5 stages
+	  double items = 5.0 * 10000 * n;
+	  std::cout << "time for rk4_double: " << timer_report(t2 - t1, items) << std::endl;
+	  std::cout << "time for rk4_float:  " << timer_report(t3 - t2, items) << std::endl;
+	  std::cout << "time for rk4_exp:    " << timer_report(t4 - t3, items) << std::endl;
+	  std::cout << "time for rk4_exp (fused): " << timer_report(t5 - t4, items) << std::endl;
+	  print_counters("rk4_exp", p3, p4, items);
+	  print_counters("rk4_exp (fused)", p4, p5, items);
 
-	  std::cout << "time for rk4_double: " << (t2 - t1) / CPU_SPEED << "s" << std::endl;
-	  std::cout << "time for rk4_float:  " << (t3 - t2) / CPU_SPEED << "s" << std::endl;
-	  std::cout << "time for rk4_exp:    " << (t4 - t3) / CPU_SPEED << "s" << std::endl;
+	  delete[] fqtmp;
 
 
 
@@ -250,156 +994,208 @@ int main(int argc, char* argv[]) {
   std::cout << "." << std::endl;
 
 
-  //! @hari - 8 Oct 2016 - for Fall NSF Large 2016.
-  std::cout << "Stage  Hierarchical-FP " << std::endl;
+  std::cout << "Stage  expansion file " << std::endl;
   {
 	  dr::tab scope;
 
-	  unsigned long n = atol(argv[1]); //  1000000;
-	  __float128  *sin2pi_q = new __float128[n];
-
-	  char buf[128];
-	  int width = 46;   
-
-	  std::cout << "[info] initializing quad precision sine curve." << std::endl;
-	  // sin2pi_q[0] = sinq(0.0q);
-	  for (int i=0; i<n; ++i) {
-		  sin2pi_q[i] = sinq(M_PIq * 2 * i / n / atoi(argv[2]) );
-		  // quadmath_snprintf (buf, sizeof(buf), "%+-.80Qe", hello[i]);
-		  // printf("%s\n", buf);
+	  // float-float copy of N doubles, written to a file and read back
+	  // through mmap, first at float precision only and then in full
+	  char path[256];
+	  const char* tmp = getenv("TMPDIR");
+	  snprintf(path, sizeof(path), "%s/expfloat_array.bin", tmp && *tmp ? tmp : "/tmp");
+
+	  ExpansionArray<float, 2> ea(N);
+	  std::vector<double> ref(N);
+	  for (int i=0; i<N; ++i) {
+		  ref[i] = dist(mt);
+		  ea.top()[i] = (float)ref[i];
+		  ea.term(1)[i] = (float)(ref[i] - ea.top()[i]);
 	  }
-          std::cout << "done" << std::endl;
-
-	  // 128 bits hex - 0x ff ff ff ff ff ff ff ff 
-	  // loop through ... 
-	  
-          unsigned long      cnts[12] = {1};
-	  unsigned __int128  mask[12]; /* = {0x000000000000000000000000000003FF, //  10
-					  0x000000000000000000000000000FFC00, //  20
-					  0x0000000000000000000000003FF00000, //  30
-					  0x0000000000000000000000FFC0000000, //  40
-					  0x00000000000000000003FF0000000000, //  50
-					  0x00000000000000000FFC000000000000, //  60
-					  0x000000000000003FF000000000000000, //  70
-					  0x000000000000FFC00000000000000000, //  80
-					  0x0000000003FF00000000000000000000, //  90
-					  0x0000000FFC0000000000000000000000, // 100
-					  0x00003FF0000000000000000000000000, // 110
-					  0x0000C000000000000000000000000000, // 112
-					  }; */
-
-          /*
-	  unsigned __int128  bits;
-	  unsigned __int128  base[12];
-
-	  bits = *((__int128 *)(sin2pi_q));
-	  std::cout << "Masks ..." << std::endl;
-	  for (int j=0; j<11; ++j) {
-		  mask[j] = 0x03FFu;
-		  mask[j] = mask[j] << j*10; 
-		  base[j] = bits & mask[j];
-
-		  // printf ("%d: mask = ", j);
-		  // print_u128_u(mask[j]);
-		  // printf("\n");
-		  printf("%d:   \t  %016" PRIx64 "%016" PRIx64 "\n",j,(uint64)(mask[j]>>64),(uint64)mask[j]);
 
+	  MappedExpansionArray<float, 2> mapped;
+	  t1 = timer_ticks();
+	  bool ok = exp_file_write(path, ea);
+	  t2 = timer_ticks();
+	  if (!ok || !mapped.open(path)) {
+		  std::cout << "[error] cannot write or map " << path << ": " << strerror(errno) << std::endl;
+	  } else {
+		  double err1 = 0.0, err2 = 0.0;
+		  unsigned long bytes = N * sizeof(float);
+
+		  // cold reads: the file is not in the page cache
+		  mapped.drop_cache();
+		  t3 = timer_ticks();
+		  const float* top = mapped.top();
+		  for (int i=0; i<N; ++i)
+			  err1 = std::max(err1, std::abs(ref[i] - top[i]));
+		  t4 = timer_ticks();
+		  const float* low = mapped.term(1);
+		  unsigned long before = mapped.resident(1);
+		  for (int i=0; i<N; ++i)
+			  err2 = std::max(err2, std::abs(ref[i] - ((double)top[i] + low[i])));
+		  t5 = timer_ticks();
+
+		  std::cout << "\twrite:\t" << timer_report(t2 - t1, N) << ", "
+		            << 2 * bytes / timer_seconds(t2 - t1) * 1e-9 << " GB/s" << std::endl;
+		  std::cout << "\tterm 0 only:\t" << timer_report(t4 - t3, N) << ", max error " << err1
+		            << ", term 1 resident " << before << " of " << bytes << " bytes" << std::endl;
+		  std::cout << "\tterm 1 on demand:\t" << timer_report(t5 - t4, N) << ", max error " << err2
+		            << ", term 1 resident " << mapped.resident(1) << " bytes" << std::endl;
 	  }
-	  mask[11] = 0x03u;
-	  mask[11] = mask[11] << 110; 
-	  base[11] = bits & mask[11];
-	  printf("%d: \t  %016" PRIx64 "%016" PRIx64 "\n",11,(uint64)(mask[11]>>64),(uint64)mask[11]);
-
-	  quadmath_snprintf (buf, sizeof(buf), "%+-.32Qe", sin2pi_q[1] - sin2pi_q[0]);
-	  printf("sin(2 pi x) -- %s\n", buf);
-	  quadmath_snprintf (buf, sizeof(buf), "%+-.32Qe", sin2pi_q[2] - sin2pi_q[1]);
-	  printf("sin(2 pi x) -- %s\n", buf);
-	  quadmath_snprintf (buf, sizeof(buf), "%+-.32Qe", sin2pi_q[3] - sin2pi_q[2]);
-	  printf("sin(2 pi x) -- %s\n", buf);
-	  quadmath_snprintf (buf, sizeof(buf), "%+-.32Qe", sin2pi_q[4] - sin2pi_q[3]);
-	  printf("sin(2 pi x) -- %s\n", buf);
-	  quadmath_snprintf (buf, sizeof(buf), "%+-.32Qe", sin2pi_q[5] - sin2pi_q[4]);
-	  printf("sin(2 pi x) -- %s\n", buf);
-	   */
-  __float128 r1,r2,r3,r4;
-  
-  
-  double d, d_prev;
-  unsigned long  d_cnt, f_cnt;
-
-  {
-      dr::tab scope2;
-      std::cout << "Stage  H-double instead of float " << std::endl;
-
-      // approx by 2x double 
-      d = static_cast<double> ( sin2pi_q[0] );
-      r1 = d;
-      r2 = sin2pi_q[0] - r1;  
-      d_cnt = 2;
-      d_prev = d;
-      for (int i=1; i<n; ++i) {
-        d = static_cast<double> ( sin2pi_q[i] - sin2pi_q[i-1]);
-	double err = std::abs(d-d_prev);
-	if ( err < 1e-16 ) { // almost_equal(d, d_prev, 10) ) {
-	  r2 = sin2pi_q[i]  - sin2pi_q[i-1] - r1;
-	  d_cnt++;  
-	} else {
-	  // double err = std::abs(d-d_prev);
-	  // printf("error is %g\n", err);
-	  r1 = d;
-	  r2 = sin2pi_q[i]  - sin2pi_q[i-1] - r1;
-	  d_prev = d;
-	  d_cnt+=2;  
-	}	
-      }
-
-      std::cout << "[info] Storage by doubles instead of quads." << std::endl;
-      std::cout << "\tquad storage:\t" << n*16 << " bytes " << std::endl; 
-      std::cout << "\tdouble storage:\t" << d_cnt*8 << " bytes" << std::endl; 
-
-      delete [] sin2pi_q;
+	  mapped.close();
+	  remove(path);
   }
   std::cout << "." << std::endl;
 
 
-  double  *sin2pi = new double[n];
-
-  for (int i=0; i<n; ++i) {
-    sin2pi[i] = sin(M_PI * 2 * i / n  );
-  }
-  
-  double d1, d2;
-  float f,f_prev;
+  //! @hari - 8 Oct 2016 - for Fall NSF Large 2016.
+  std::cout << "Stage  Hierarchical-FP " << std::endl;
   {
-      dr::tab scope2;
-      std::cout << "Stage  H-float instead of double " << std::endl;
-      f = static_cast<float> ( sin2pi[0] );
-      d1 = f;
-      d2 = sin2pi[0] - d1;  
-      f_cnt = 2;
-      f_prev = f;
-      for (int i=1; i<n; ++i) {
-        f = static_cast<float> ( sin2pi[i] - sin2pi[i-1]);
-	double err = std::abs(f-f_prev);
-	if ( err < 1e-8 ) { // almost_equal(d, d_prev, 10) ) {
-		d2 = sin2pi[i] - d1;
-		f_cnt++;  
-	} else {
-		// double err = std::abs(d-d_prev);
-		// printf("error is %g\n", err);
-		d1 = f;
-		d2 = sin2pi[i] - d1;
-		f_prev = f;
-		f_cnt+=2;  
-	}	
-      }
-      std::cout << "[info] Storage by floats instead of doubles." << std::endl;
-      std::cout << "\tdouble storage:\t" << n*8 << " bytes " << std::endl; 
-      std::cout << "\tfloat storage:\t" << f_cnt*4 << " bytes" << std::endl; 
-
-      delete [] sin2pi;
+	  dr::tab scope;
+
+	  unsigned long n = atol(argv[1]); //  1000000;
+	  unsigned long periods = atoi(argv[2]);
+
+	  // the whole field in memory, and the codec on it; larger n only streams
+	  if (n > HFP_MEM_MAX)
+		  std::cout << "[warn] n > " << HFP_MEM_MAX << ", in-memory stages skipped" << std::endl;
+	  else {
+		  __float128  *sin2pi_q = new __float128[n];
+
+		  std::cout << "[info] initializing quad precision sine curve." << std::endl;
+		  t1 = timer_ticks();
+		  bool cached = gen_cached("sine_q-" + std::to_string(n) + "-" + std::to_string(periods), sin2pi_q, n,
+		                           [&](__float128* v) { gen_sine(v, 0, n, n, periods); });
+		  t2 = timer_ticks();
+		  std::cout << "done " << (cached ? "(cached) " : "") << timer_report(t2 - t1, n) << std::endl;
+
+		  unsigned long  d_cnt, f_cnt;
+
+		  {
+		      dr::tab scope2;
+		      std::cout << "Stage  H-double instead of float " << std::endl;
+
+		      t1 = timer_ticks();
+		      d_cnt = hfp_count(sin2pi_q, n);
+		      t2 = timer_ticks();
+
+		      std::cout << "[info] Storage by doubles instead of quads." << std::endl;
+		      std::cout << "\tquad storage:\t" << n*16 << " bytes " << std::endl; 
+		      std::cout << "\tdouble storage:\t" << d_cnt*8 << " bytes" << std::endl; 
+		      std::cout << "\ttime:\t" << timer_report(t2 - t1, n) << std::endl;
+
+		      hfp_report<__float128>("hfp codec", sin2pi_q, n, 0);
+		      hfp_report<__float128>("hfp codec", sin2pi_q, n, 1e-16);
+		      hfp_report<__float128>("hfp codec", sin2pi_q, n, 1e-24);
+
+		      delete [] sin2pi_q;
+		  }
+		  std::cout << "." << std::endl;
+
+
+		  double  *sin2pi = new double[n];
+
+		  gen_cached("sine_d-" + std::to_string(n), sin2pi, n, [&](double* v) { gen_sine(v, 0, n, n); });
+
+		  float f,f_prev;
+		  {
+		      dr::tab scope2;
+		      std::cout << "Stage  H-float instead of double " << std::endl;
+		      t1 = timer_ticks();
+		      f_cnt = hfp_count(sin2pi, n);
+		      t2 = timer_ticks();
+
+		      std::cout << "[info] Storage by floats instead of doubles." << std::endl;
+		      std::cout << "\tdouble storage:\t" << n*8 << " bytes " << std::endl; 
+		      std::cout << "\tfloat storage:\t" << f_cnt*4 << " bytes" << std::endl; 
+		      std::cout << "\ttime:\t" << timer_report(t2 - t1, n) << std::endl;
+
+		      hfp_report<double>("hfp codec", sin2pi, n, 0);
+		      hfp_report<double>("hfp codec", sin2pi, n, 1e-8);
+		      hfp_report<double>("hfp codec", sin2pi, n, 1e-12);
+
+		      // the same field with low terms only where float alone is off by more
+		      // than tol relative. The rounding error of a float is at most 2^-24
+		      // (6e-8) relative, so a tol above that stores no low terms and the
+		      // range across it shows the storage against the error
+		      const float tols[4] = {1e-6f, 5e-8f, 2e-8f, 1e-8f};
+		      for (int k = 0; k < 4; ++k) {
+		        AdaptiveExpansionArray adaptive(n, tols[k]);
+		        adaptive.assign(sin2pi);
+		        double err = 0.0;
+		        for (unsigned long i=0; i<n; ++i) {
+		          adaptive.get(i, f, f_prev);
+		          err = std::max(err, std::abs(sin2pi[i] - ((double)f + f_prev)));
+		        }
+		        std::cout << "\tadaptive storage (tol " << tols[k] << "):\t" << adaptive.bytes() << " bytes, "
+		                  << adaptive.low_count() << " low terms, max error " << err << std::endl;
+		      }
+
+		      delete [] sin2pi;
+		  }
+		  std::cout << "." << std::endl;
+	  }
   }
   std::cout << "." << std::endl;
+
+
+  std::cout << "Stage  H-stream " << std::endl;
+  {
+	  dr::tab scope;
+
+	  unsigned long n = atol(argv[1]);
+	  unsigned long periods = atoi(argv[2]);
+
+	  // the quad sine generated chunk by chunk, through a file and back, so n
+	  // is bounded by the disk rather than memory
+	  char path[256];
+	  const char* tmp = getenv("TMPDIR");
+	  snprintf(path, sizeof(path), "%s/expfloat_hfp.bin", tmp && *tmp ? tmp : "/tmp");
+
+	  __float128 tol = 1e-24;
+	  unsigned long next = 0, bad = 0;
+	  double err = 0.0;
+	  HfpStreamStats enc, dec;
+
+	  HfpSource<__float128> source = [&](__float128* buf, unsigned long max) {
+	      unsigned long len = std::min(max, n - next);
+	      gen_sine(buf, next, len, n, periods);
+	      next += len;
+	      return len;
+	  };
+	  HfpSink<__float128> check = [&](const __float128* v, unsigned long len, unsigned long first) {
+	      std::vector<__float128> ref(len);
+	      gen_sine(ref.data(), first, len, n, periods);
+	      for (unsigned long j = 0; j < len; ++j) {
+	          __float128 d = fabsq(v[j] - ref[j]);
+	          err = std::max(err, (double)d);
+	          bad += !(d <= tol);
+	      }
+	  };
+
+	  HfpSink<__float128> discard = [](const __float128*, unsigned long, unsigned long) {};
+
+	  if (!hfp_encode_stream(source, path, tol, enc)) {
+	      std::cout << "[error] cannot write " << path << ": " << strerror(errno) << std::endl;
+	  } else {
+	      std::streamsize prec = std::cout.precision();
+	      std::cout << "[info] " << n << " values, " << enc.chunks << " chunks, at most "
+	                << 3 * HFP_STREAM_DEPTH * HFP_STREAM_CHUNK * sizeof(__float128) / (1 << 20) << " MB in flight" << std::endl;
+	      std::cout << "\tfile:\t" << enc.file_bytes << " bytes, ratio " << std::setprecision(4) << enc.ratio() << std::endl;
+	      std::cout << "\tencode (with sinq):\t" << timer_report(enc.ticks, n) << ", " << enc.gbps() << " GB/s" << std::endl;
+	      if (!hfp_decode_stream(path, discard, dec))
+	          std::cout << "[error] cannot read " << path << ": " << strerror(errno) << std::endl;
+	      else
+	          std::cout << "\tdecode:\t" << timer_report(dec.ticks, n) << ", " << dec.gbps() << " GB/s" << std::endl;
+	      if (!hfp_decode_stream(path, check, dec))
+	          std::cout << "[error] cannot read " << path << ": " << strerror(errno) << std::endl;
+	      else if (dec.n != n)
+	          std::cout << "[error] " << path << ": " << dec.n << " values read back, " << n << " written" << std::endl;
+	      std::cout << "\t" << (bad ? "error: " : "") << "round trip: max error " << err
+	                << ", " << bad << " values off" << std::endl;
+	      std::cout.precision(prec);
+	  }
+	  remove(path);
   }
   std::cout << "." << std::endl;
   